@@ -0,0 +1,235 @@
+/*
+ *	ABDADA.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <string.h>
+#include <omp.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This is an ABDADA search (after Weill's "Alpha-Bêta Distribué avec
+   Droit d'Aînesse"), in the simplified form Tom Kerrigan describes:
+   every thread searches the whole tree from the root, on its own copy
+   of the board. Before searching a node, a thread marks it busy in a
+   small shared hash table. A thread that finds the node it's about to
+   search already marked (other than a node's first move, its "eldest
+   son") puts it off and searches the next move instead, coming back to
+   the ones it put off at the end. Threads share their results through
+   the transposition table, so by then the work has usually been done.
+   Nothing is ever copied between threads. */
+
+#define ABDADA_MIN_DEPTH	3  /* don't mark nodes with less depth than this */
+#define ABDADA_SIZE			32768  /* slots in the busy table... */
+#define ABDADA_WAYS			4  /* ...and keys per slot */
+#define ABDADA_DEFER		256  /* most moves a node can put off */
+
+volatile U64 abdada_table[ABDADA_SIZE][ABDADA_WAYS];
+flag_t abdada_done;
+
+
+/* abdada_search() does search in parallel by ABDADA. Thread 0's
+   result is the one that counts; the helpers stop when it's done. */
+
+int abdada_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, x = alpha;
+	pos_t *h;
+
+	/* the helpers follow the same PV as thread 0 */
+	for (i = 1; i < threads; ++i) {
+		h = &pos_dat[i];
+		memcpy(h->pv, p->pv, sizeof(p->pv));
+		memcpy(h->pv_length, p->pv_length, sizeof(p->pv_length));
+		h->follow_pv = p->follow_pv;
+	}
+
+	abdada_done.val = FALSE;
+	#pragma omp parallel shared(x)
+	{
+		if (omp_get_thread_num() == 0) {
+			x = abdada(p, alpha, beta, depth);
+			abdada_done.val = TRUE;
+		}
+		else
+			abdada(&pos_dat[omp_get_thread_num()], alpha, beta, depth);
+	}
+
+	/* hash cutoffs at PV nodes leave the PV short, so fill it out
+	   from the table before it's printed and followed next time */
+	if (!stop_search.val)
+		tt_pv(p);
+	return x;
+}
+
+
+/* abdada() is search(), except that it puts off moves that another
+   thread is already searching. */
+
+int abdada(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, j, k, n, x;
+	int deferred[ABDADA_DEFER];
+	BOOL c, f, mark;
+	U64 key;
+	move best, hash_move;
+
+	/* we're as deep as we want to be; call quiesce() to get
+	   a reasonable score and return it. */
+	if (!depth)
+		return (*quiesce_func)(p, alpha,beta);
+
+	++p->nodes;
+
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
+		return alpha;
+
+	p->pv_length[p->ply] = p->ply;
+
+	/* if this isn't the root of the search tree (where we have
+	   to pick a move and can't simply return 0) then check to
+	   see if the position is a repeat. if so, we can assume that
+	   this line is a draw and return 0. */
+	if (p->ply && reps(p))
+		return 0;
+
+	/* are we too deep? */
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
+
+	/* are we in check? if so, we want to search deeper */
+	c = in_check(p, p->side);
+	if (c)
+		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
+
+	gen(p);
+
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+
+	f = FALSE;
+	best.u = 0;
+	n = 0;
+	mark = depth >= ABDADA_MIN_DEPTH;
+
+	/* loop through the moves, then through the ones we put off */
+	for (k = p->first_move[p->ply]; k < p->first_move[p->ply + 1] + n; ++k) {
+		if (k < p->first_move[p->ply + 1]) {
+			i = k;
+			sort(p, i);
+		}
+		else
+			i = deferred[k - p->first_move[p->ply + 1]];
+		makemove(p, p->gen_dat[i].m.b);
+		key = p->hash;
+
+		/* is another thread searching this move? if so, and it's
+		   not the first move, come back to it later */
+		if (mark && f && k < p->first_move[p->ply + 1] && n < ABDADA_DEFER &&
+				abdada_busy(key)) {
+			takeback(p);
+			deferred[n++] = i;
+			continue;
+		}
+		f = TRUE;
+		if (mark)
+			abdada_start(key);
+		x = -abdada(p, -beta, -alpha, depth - 1);
+		if (mark)
+			abdada_finish(key);
+		takeback(p);
+		if (stop_search.val || abdada_done.val)
+			return alpha;
+		if (x > alpha) {
+
+			/* this move caused a cutoff, so increase the history
+			   value so it gets ordered high next time we can
+			   search it */
+			p->history[(int)p->gen_dat[i].m.b.from][(int)p->gen_dat[i].m.b.to] += depth;
+			if (x >= beta) {
+				tt_store(p, depth, beta, TT_LOWER, p->gen_dat[i].m);
+				return beta;
+			}
+			alpha = x;
+			best = p->gen_dat[i].m;
+
+			/* update the PV */
+			p->pv[p->ply][p->ply] = p->gen_dat[i].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
+		}
+	}
+
+	/* no legal moves? then we're in checkmate or stalemate */
+	if (!f) {
+		if (c)
+			return -10000 + p->ply;
+		else
+			return 0;
+	}
+
+	/* fifty move draw rule */
+	if (p->fifty >= 100)
+		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
+	return alpha;
+}
+
+
+/* abdada_busy() returns TRUE if some thread is searching the
+   position with hash key. */
+
+BOOL abdada_busy(U64 key)
+{
+	int i;
+	volatile U64 *slot = abdada_table[key & (ABDADA_SIZE - 1)];
+
+	for (i = 0; i < ABDADA_WAYS; ++i)
+		if (slot[i] == key)
+			return TRUE;
+	return FALSE;
+}
+
+
+/* abdada_start() marks the position with hash key as busy. If its
+   slot is full, the position just doesn't get marked. */
+
+void abdada_start(U64 key)
+{
+	int i;
+	volatile U64 *slot = abdada_table[key & (ABDADA_SIZE - 1)];
+
+	for (i = 0; i < ABDADA_WAYS; ++i)
+		if (!slot[i] && __sync_bool_compare_and_swap(&slot[i], 0, key))
+			return;
+}
+
+
+/* abdada_finish() takes the mark off the position with hash key. */
+
+void abdada_finish(U64 key)
+{
+	int i;
+	volatile U64 *slot = abdada_table[key & (ABDADA_SIZE - 1)];
+
+	for (i = 0; i < ABDADA_WAYS; ++i)
+		if (slot[i] == key && __sync_bool_compare_and_swap(&slot[i], key, 0))
+			return;
+}
@@ -0,0 +1,452 @@
+/*
+ *	BITBOARD.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+#ifdef BITBOARD
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+
+/* This is the bitboard version of the move generator and attack test,
+   used instead of the mailbox code in board.c when the program is
+   built with BITBOARD defined. Each position keeps a 64-bit set of
+   squares for every piece type of each color (bb and bb_side in
+   pos_t), which makemove() and takeback() update along with the
+   mailbox. Knight, king and pawn attacks come from tables indexed by
+   square. Slider attacks come from "magic" tables: the occupied
+   squares on a slider's lines (less the edges, which can't block
+   anything) are multiplied by a magic number that packs them into
+   the top bits, which index a table of the attacked squares. With
+   BMI2 (e.g., -march=haswell), the PEXT instruction does the packing
+   instead. The magics are found at startup by trial and error.
+
+   Bit n is square n, numbered like the mailbox: 0 is A8, 63 is H1.
+   The moves come out in a different order than the mailbox code's,
+   so the search's move ordering ties (and so its node counts) can
+   differ, but the sets of moves are the same; bb_check() checks that
+   they are. */
+
+#define BB_FIRST(b)		__builtin_ctzll(b)
+#define BB_COUNT(b)		__builtin_popcountll(b)
+
+U64 bb_knight[64];
+U64 bb_king[64];
+U64 bb_pawn[2][64];  /* the squares a pawn of each color attacks */
+bb_magic bb_rook[64];
+bb_magic bb_bishop[64];
+U64 bb_rook_table[102400];
+U64 bb_bishop_table[5248];
+
+int bb_rook_dir[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+int bb_bishop_dir[4][2] = { { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } };
+
+U64 bb_seed = 0x9e3779b97f4a7c15ULL;  /* for bb_rand() */
+int bb_printed;  /* how many bad positions bb_check() has printed */
+
+
+/* bb_init() fills in the attack tables. */
+
+void bb_init()
+{
+	int sq, i, r, c;
+	int knight[8][2] = { { -2, -1 }, { -2, 1 }, { -1, -2 }, { -1, 2 },
+			{ 1, -2 }, { 1, 2 }, { 2, -1 }, { 2, 1 } };
+	U64 *rook = bb_rook_table, *bishop = bb_bishop_table;
+
+	for (sq = 0; sq < 64; ++sq) {
+		bb_knight[sq] = 0;
+		bb_king[sq] = 0;
+		bb_pawn[LIGHT][sq] = 0;
+		bb_pawn[DARK][sq] = 0;
+		for (i = 0; i < 8; ++i) {
+			r = ROW(sq) + knight[i][0];
+			c = COL(sq) + knight[i][1];
+			if (r >= 0 && r < 8 && c >= 0 && c < 8)
+				bb_knight[sq] |= 1ULL << (r * 8 + c);
+		}
+		for (r = ROW(sq) - 1; r <= ROW(sq) + 1; ++r)
+			for (c = COL(sq) - 1; c <= COL(sq) + 1; ++c)
+				if (r >= 0 && r < 8 && c >= 0 && c < 8 && r * 8 + c != sq)
+					bb_king[sq] |= 1ULL << (r * 8 + c);
+		for (c = COL(sq) - 1; c <= COL(sq) + 1; c += 2) {
+			if (c < 0 || c > 7)
+				continue;
+			if (ROW(sq) > 0)
+				bb_pawn[LIGHT][sq] |= 1ULL << ((ROW(sq) - 1) * 8 + c);
+			if (ROW(sq) < 7)
+				bb_pawn[DARK][sq] |= 1ULL << ((ROW(sq) + 1) * 8 + c);
+		}
+
+		rook += bb_init_magic(&bb_rook[sq], sq, bb_rook_dir, rook);
+		bishop += bb_init_magic(&bb_bishop[sq], sq, bb_bishop_dir, bishop);
+	}
+}
+
+
+/* bb_slide() returns the squares attacked from square sq along the
+   four directions dir, given the occupied squares occ. If edges is
+   FALSE, the last square in each direction is left out. */
+
+U64 bb_slide(int sq, int dir[4][2], U64 occ, BOOL edges)
+{
+	int i, r, c;
+	U64 b = 0;
+
+	for (i = 0; i < 4; ++i)
+		for (r = ROW(sq) + dir[i][0], c = COL(sq) + dir[i][1];
+				r >= 0 && r < 8 && c >= 0 && c < 8;
+				r += dir[i][0], c += dir[i][1]) {
+			if (!edges && (r + dir[i][0] < 0 || r + dir[i][0] > 7 ||
+					c + dir[i][1] < 0 || c + dir[i][1] > 7))
+				break;
+			b |= 1ULL << (r * 8 + c);
+			if (occ & (1ULL << (r * 8 + c)))
+				break;
+		}
+	return b;
+}
+
+
+/* bb_init_magic() sets up m, the attack table of a slider that moves
+   along dir from square sq, with its entries at table. It returns the
+   number of entries used. */
+
+int bb_init_magic(bb_magic *m, int sq, int dir[4][2], U64 *table)
+{
+	int i, j, n, bits;
+	U64 occ[4096], att[4096], b;
+
+	m->mask = bb_slide(sq, dir, 0, FALSE);
+	m->attacks = table;
+	bits = BB_COUNT(m->mask);
+	m->shift = 64 - bits;
+	n = 0;
+	b = 0;
+	do {  /* every subset of mask */
+		occ[n] = b;
+		att[n++] = bb_slide(sq, dir, b, TRUE);
+		b = (b - m->mask) & m->mask;
+	} while (b);
+
+#ifdef __BMI2__
+	m->magic = 0;
+	for (i = 0; i < n; ++i)
+		table[_pext_u64(occ[i], m->mask)] = att[i];
+#else
+	for (;;) {
+		m->magic = bb_rand() & bb_rand() & bb_rand();
+		if (BB_COUNT((m->mask * m->magic) >> 56) < 6)
+			continue;
+		memset(table, 0, n * sizeof(U64));
+		for (i = 0; i < n; ++i) {
+			j = (int)((occ[i] * m->magic) >> m->shift);
+			if (table[j] && table[j] != att[i])
+				break;
+			table[j] = att[i];
+		}
+		if (i == n)
+			break;
+	}
+#endif
+	return n;
+}
+
+
+/* bb_rand() returns a pseudorandom 64-bit number (xorshift64*). It
+   always starts from the same seed, so the magics are the same from
+   run to run. */
+
+U64 bb_rand()
+{
+	bb_seed ^= bb_seed >> 12;
+	bb_seed ^= bb_seed << 25;
+	bb_seed ^= bb_seed >> 27;
+	return bb_seed * 2685821657736338717ULL;
+}
+
+
+/* bb_rook_attacks() and bb_bishop_attacks() return the squares a rook
+   or bishop on square sq attacks, given the occupied squares occ. */
+
+U64 bb_rook_attacks(int sq, U64 occ)
+{
+	bb_magic *m = &bb_rook[sq];
+
+#ifdef __BMI2__
+	return m->attacks[_pext_u64(occ, m->mask)];
+#else
+	return m->attacks[((occ & m->mask) * m->magic) >> m->shift];
+#endif
+}
+
+U64 bb_bishop_attacks(int sq, U64 occ)
+{
+	bb_magic *m = &bb_bishop[sq];
+
+#ifdef __BMI2__
+	return m->attacks[_pext_u64(occ, m->mask)];
+#else
+	return m->attacks[((occ & m->mask) * m->magic) >> m->shift];
+#endif
+}
+
+
+/* bb_set() sets position p's bitboards from its mailbox. It's called
+   by plist_set(). */
+
+void bb_set(pos_t *p)
+{
+	int i;
+
+	memset(p->bb, 0, sizeof(p->bb));
+	memset(p->bb_side, 0, sizeof(p->bb_side));
+	for (i = 0; i < 64; ++i)
+		if (p->color[i] != EMPTY)
+			BB_TOGGLE(p, p->color[i], p->piece[i], i);
+}
+
+
+/* bb_attack() returns TRUE if square sq is being attacked by side s
+   and FALSE otherwise. It looks from sq for each kind of piece,
+   instead of looking at every one of side s's pieces. */
+
+BOOL bb_attack(pos_t *p, int sq, int s)
+{
+	U64 occ = p->bb_side[LIGHT] | p->bb_side[DARK];
+
+	return ((bb_pawn[s ^ 1][sq] & p->bb[s][PAWN]) ||
+			(bb_knight[sq] & p->bb[s][KNIGHT]) ||
+			(bb_king[sq] & p->bb[s][KING]) ||
+			(bb_bishop_attacks(sq, occ) & (p->bb[s][BISHOP] | p->bb[s][QUEEN])) ||
+			(bb_rook_attacks(sq, occ) & (p->bb[s][ROOK] | p->bb[s][QUEEN])));
+}
+
+
+/* bb_in_check() returns TRUE if side s is in check and FALSE
+   otherwise. */
+
+BOOL bb_in_check(pos_t *p, int s)
+{
+	if (!p->bb[s][KING])
+		return TRUE;  /* shouldn't get here */
+	return bb_attack(p, BB_FIRST(p->bb[s][KING]), s ^ 1);
+}
+
+
+/* bb_targets() returns the squares the piece on square sq attacks,
+   for any piece but a pawn. */
+
+U64 bb_targets(pos_t *p, int sq)
+{
+	U64 occ = p->bb_side[LIGHT] | p->bb_side[DARK];
+
+	switch (p->piece[sq]) {
+		case KNIGHT:
+			return bb_knight[sq];
+		case BISHOP:
+			return bb_bishop_attacks(sq, occ);
+		case ROOK:
+			return bb_rook_attacks(sq, occ);
+		case QUEEN:
+			return bb_bishop_attacks(sq, occ) | bb_rook_attacks(sq, occ);
+		case KING:
+			return bb_king[sq];
+	}
+	return 0;
+}
+
+
+/* bb_gen() generates the same pseudo-legal moves as mailbox_gen(). */
+
+void bb_gen(pos_t *p)
+{
+	int i, n;
+	U64 b, t, occ = p->bb_side[LIGHT] | p->bb_side[DARK];
+
+	/* so far, we have no moves for the current ply */
+	p->first_move[p->ply + 1] = p->first_move[p->ply];
+
+	for (b = p->bb_side[p->side]; b; b &= b - 1) {
+		i = BB_FIRST(b);
+		if (p->piece[i] == PAWN) {
+			for (t = bb_pawn[p->side][i] & p->bb_side[p->xside]; t; t &= t - 1)
+				gen_push(p, i, BB_FIRST(t), 17);
+			n = p->side == LIGHT ? i - 8 : i + 8;
+			if (!(occ & (1ULL << n))) {
+				gen_push(p, i, n, 16);
+				if (p->side == LIGHT && i >= 48 && !(occ & (1ULL << (i - 16))))
+					gen_push(p, i, i - 16, 24);
+				if (p->side == DARK && i <= 15 && !(occ & (1ULL << (i + 16))))
+					gen_push(p, i, i + 16, 24);
+			}
+			continue;
+		}
+		t = bb_targets(p, i);
+		for (t &= ~p->bb_side[p->side]; t; t &= t - 1) {
+			n = BB_FIRST(t);
+			gen_push(p, i, n, (occ & (1ULL << n)) ? 1 : 0);
+		}
+	}
+
+	/* generate castle moves */
+	if (p->side == LIGHT) {
+		if (p->castle & 1)
+			gen_push(p, E1, G1, 2);
+		if (p->castle & 2)
+			gen_push(p, E1, C1, 2);
+	}
+	else {
+		if (p->castle & 4)
+			gen_push(p, E8, G8, 2);
+		if (p->castle & 8)
+			gen_push(p, E8, C8, 2);
+	}
+
+	/* generate en passant moves */
+	if (p->ep != -1)
+		for (b = bb_pawn[p->xside][p->ep] & p->bb[p->side][PAWN]; b; b &= b - 1)
+			gen_push(p, BB_FIRST(b), p->ep, 21);
+}
+
+
+/* bb_gen_caps() generates the same capture and promote moves as
+   mailbox_gen_caps(). */
+
+void bb_gen_caps(pos_t *p)
+{
+	int i, n;
+	U64 b, t, occ = p->bb_side[LIGHT] | p->bb_side[DARK];
+
+	p->first_move[p->ply + 1] = p->first_move[p->ply];
+	for (b = p->bb_side[p->side]; b; b &= b - 1) {
+		i = BB_FIRST(b);
+		if (p->piece[i] == PAWN) {
+			for (t = bb_pawn[p->side][i] & p->bb_side[p->xside]; t; t &= t - 1)
+				gen_push(p, i, BB_FIRST(t), 17);
+			n = p->side == LIGHT ? i - 8 : i + 8;
+			if ((n <= H8 || n >= A1) && !(occ & (1ULL << n)))
+				gen_push(p, i, n, 16);
+			continue;
+		}
+		for (t = bb_targets(p, i) & p->bb_side[p->xside]; t; t &= t - 1)
+			gen_push(p, i, BB_FIRST(t), 1);
+	}
+	if (p->ep != -1)
+		for (b = bb_pawn[p->xside][p->ep] & p->bb[p->side][PAWN]; b; b &= b - 1)
+			gen_push(p, BB_FIRST(b), p->ep, 21);
+}
+
+
+/* bb_check() checks the bitboard code against the mailbox code in
+   every position up to depth ply from p: the bitboards themselves
+   (and the piece lists, which the mailbox code uses),
+   the pseudo-legal moves generated (in any order), and which
+   squares are attacked. It prints the first few positions where they
+   differ, and returns how many there were. nodes is increased by the
+   number of positions checked. */
+
+int bb_check(pos_t *p, int depth, int *nodes)
+{
+	int i, n, errors = 0;
+	BOOL bad = FALSE;
+	char fen[128];
+	U64 bb[2][6];
+	unsigned char list[2][16];
+	int count[2], king[2];
+	gen_t a[512];
+
+	if (!p->ply)
+		bb_printed = 0;
+	++*nodes;
+
+	memcpy(bb, p->bb, sizeof(bb));
+	memcpy(list, p->piece_list, sizeof(list));
+	memcpy(count, p->piece_count, sizeof(count));
+	memcpy(king, p->king_sq, sizeof(king));
+	plist_set(p);
+	if (memcmp(bb, p->bb, sizeof(bb)) ||
+			memcmp(count, p->piece_count, sizeof(count)) ||
+			memcmp(king, p->king_sq, sizeof(king)) ||
+			memcmp(list[LIGHT], p->piece_list[LIGHT], count[LIGHT]) ||
+			memcmp(list[DARK], p->piece_list[DARK], count[DARK]))
+		bad = TRUE;
+	for (i = 0; i < 64; ++i)
+		if (mailbox_attack(p, i, LIGHT) != bb_attack(p, i, LIGHT) ||
+				mailbox_attack(p, i, DARK) != bb_attack(p, i, DARK))
+			bad = TRUE;
+	if (mailbox_in_check(p, LIGHT) != bb_in_check(p, LIGHT) ||
+			mailbox_in_check(p, DARK) != bb_in_check(p, DARK))
+		bad = TRUE;
+
+	mailbox_gen_caps(p);
+	n = bb_moves(p, a);
+	bb_gen_caps(p);
+	if (bb_moves(p, a + n) != n || memcmp(a, a + n, n * sizeof(gen_t)))
+		bad = TRUE;
+	mailbox_gen(p);
+	n = bb_moves(p, a);
+	bb_gen(p);
+	if (bb_moves(p, a + n) != n || memcmp(a, a + n, n * sizeof(gen_t)))
+		bad = TRUE;
+
+	if (bad) {
+		++errors;
+		if (bb_printed++ < 10) {
+			fen_str(p, fen);
+			printf("Bitboards differ from the mailbox at %s\n", fen);
+		}
+	}
+
+	if (depth <= 0 || p->ply >= MAX_PLY - 1)
+		return errors;
+	gen(p);
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		makemove(p, p->gen_dat[i].m.b);
+		errors += bb_check(p, depth - 1, nodes);
+		takeback(p);
+	}
+	return errors;
+}
+
+
+/* bb_moves() copies the moves just generated at the current ply to a,
+   sorted so that lists can be compared, and returns how many there
+   are. */
+
+int bb_moves(pos_t *p, gen_t *a)
+{
+	int n = p->first_move[p->ply + 1] - p->first_move[p->ply];
+
+	if (n > 256)  /* can't happen in a legal position */
+		n = 256;
+	memcpy(a, &p->gen_dat[p->first_move[p->ply]], n * sizeof(gen_t));
+	qsort(a, n, sizeof(gen_t), &bb_compare);
+	return n;
+}
+
+
+/* bb_compare() orders moves for qsort(). */
+
+int bb_compare(const void *a, const void *b)
+{
+	const gen_t *x = a, *y = b;
+
+	if (x->m.u != y->m.u)
+		return x->m.u < y->m.u ? -1 : 1;
+	return x->score < y->score ? -1 : x->score > y->score;
+}
+
+#endif /* BITBOARD */
@@ -8,36 +8,32 @@
 
 
 #include <stdlib.h>
+#include <string.h>
 #include "defs.h"
 #include "data.h"
 #include "protos.h"
 
-#pragma omp threadprivate(color, piece)
-#pragma omp threadprivate(side, xside, castle, ep, fifty, hash, ply, hply)
-#pragma omp threadprivate(gen_dat, first_move)
-#pragma omp threadprivate(hist_dat)
-#pragma omp threadprivate(pv, pv_length, follow_pv)
-
 
 /* init_board() sets the board to the initial game state. */
 
-void init_board()
+void init_board(pos_t *p)
 {
 	int i;
 
 	for (i = 0; i < 64; ++i) {
-		color[i] = init_color[i];
-		piece[i] = init_piece[i];
+		p->color[i] = init_color[i];
+		p->piece[i] = init_piece[i];
 	}
-	side = LIGHT;
-	xside = DARK;
-	castle = 15;
-	ep = -1;
-	fifty = 0;
-	ply = 0;
-	hply = 0;
-	set_hash();  /* init_hash() must be called before this function */
-	first_move[0] = 0;
+	p->side = LIGHT;
+	p->xside = DARK;
+	p->castle = 15;
+	p->ep = -1;
+	p->fifty = 0;
+	p->ply = 0;
+	p->hply = 0;
+	plist_set(p);
+	set_hash(p);  /* init_hash() must be called before this function */
+	p->first_move[0] = 0;
 }
 
 
@@ -47,7 +43,7 @@ void init_hash()
 {
 	int i, j, k;
 
-	srand(0);
+	hash_seed = 0;
 	for (i = 0; i < 2; ++i)
 		for (j = 0; j < 6; ++j)
 			for (k = 0; k < 64; ++k)
@@ -55,251 +51,538 @@ void init_hash()
 	hash_side = hash_rand();
 	for (i = 0; i < 64; ++i)
 		hash_ep[i] = hash_rand();
+	for (i = 0; i < 16; ++i)
+		hash_castle[i] = hash_rand();
 }
 
 
-/* hash_rand() XORs some shifted random numbers together to make sure
-   we have good coverage of all 32 bits. (rand() returns 16-bit numbers
-   on some systems.) */
+/* hash_rand() returns a pseudorandom 64-bit number. It's SplitMix64,
+   which (unlike XORing together rand()'s numbers, which may be only
+   15 bits) gives well-mixed numbers, and the same ones everywhere. */
 
-int hash_rand()
+U64 hash_rand()
 {
-	int i;
-	int r = 0;
+	U64 z = (hash_seed += 0x9e3779b97f4a7c15ULL);
 
-	for (i = 0; i < 32; ++i)
-		r ^= rand() << i;
-	return r;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
 }
 
 
 /* set_hash() uses the Zobrist method of generating a unique number (hash)
    for the current chess position. Of course, there are many more chess
-   positions than there are 32 bit numbers, so the numbers generated are
+   positions than there are 64 bit numbers, so the numbers generated are
    not really unique, but they're unique enough for our purposes (to detect
-   repetitions of the position). 
+   repetitions of the position, and to index the transposition table). 
    The way it works is to XOR random numbers that correspond to features of
    the position, e.g., if there's a black knight on B8, hash is XORed with
    hash_piece[BLACK][KNIGHT][B8]. All of the pieces are XORed together,
-   hash_side is XORed if it's black's move, and the en passant square is
-   XORed if there is one. (A chess technicality is that one position can't
-   be a repetition of another if the en passant state is different.) */
+   hash_side is XORed if it's black's move, the en passant square is
+   XORed if there is one, and so are the castle permissions. (A chess
+   technicality is that one position can't be a repetition of another if
+   the en passant state or castle permissions are different.) pawn_hash
+   is the same thing for just the pawns.
+
+   set_hash() computes the hashes from scratch, for a new board;
+   makemove() updates them by XORing in and out only what changed. */
 
-void set_hash()
+void set_hash(pos_t *p)
 {
 	int i;
 
-	hash = 0;	
+	p->hash = 0;
+	p->pawn_hash = 0;
 	for (i = 0; i < 64; ++i)
-		if (color[i] != EMPTY)
-			hash ^= hash_piece[color[i]][piece[i]][i];
-	if (side == DARK)
-		hash ^= hash_side;
-	if (ep != -1)
-		hash ^= hash_ep[ep];
+		if (p->color[i] != EMPTY) {
+			p->hash ^= hash_piece[p->color[i]][p->piece[i]][i];
+			if (p->piece[i] == PAWN)
+				p->pawn_hash ^= hash_piece[p->color[i]][PAWN][i];
+		}
+	if (p->side == DARK)
+		p->hash ^= hash_side;
+	if (p->ep != -1)
+		p->hash ^= hash_ep[p->ep];
+	p->hash ^= hash_castle[p->castle];
 }
 
 
-/* in_check() returns TRUE if side s is in check and FALSE
-   otherwise. It just scans the board to find side s's king
-   and calls attack() to see if it's being attacked. */
+/* plist_set() sets up position p's piece lists and king squares (and
+   its bitboards, if it has them) from its board. Whatever sets up a
+   board directly, instead of with makemove(), calls it. */
 
-BOOL in_check(int s)
+void plist_set(pos_t *p)
 {
-	int i;
+	int i, c;
 
-	for (i = 0; i < 64; ++i)
-		if (piece[i] == KING && color[i] == s)
-			return attack(i, s ^ 1);
-	return TRUE;  /* shouldn't get here */
+	p->piece_count[LIGHT] = 0;
+	p->piece_count[DARK] = 0;
+	p->king_sq[LIGHT] = -1;
+	p->king_sq[DARK] = -1;
+	for (i = 0; i < 64; ++i) {
+		c = p->color[i];
+		if (c == EMPTY)
+			continue;
+		if (p->piece_count[c] < 16)
+			p->piece_list[c][p->piece_count[c]++] = i;
+		if (p->piece[i] == KING)
+			p->king_sq[c] = i;
+	}
+#ifdef BITBOARD
+	bb_set(p);
+#endif
 }
 
 
-/* attack() returns TRUE if square sq is being attacked by side
-   s and FALSE otherwise. */
+/* plist_add() adds square sq to side c's piece list. */
 
-BOOL attack(int sq, int s)
+void plist_add(pos_t *p, int c, int sq)
 {
-	int i, j, n;
+	int k;
 
-	for (i = 0; i < 64; ++i)
-		if (color[i] == s) {
-			if (piece[i] == PAWN) {
-				if (s == LIGHT) {
-					if (COL(i) != 0 && i - 9 == sq)
-						return TRUE;
-					if (COL(i) != 7 && i - 7 == sq)
-						return TRUE;
+	for (k = p->piece_count[c]++; k > 0 && p->piece_list[c][k - 1] > sq; --k)
+		p->piece_list[c][k] = p->piece_list[c][k - 1];
+	p->piece_list[c][k] = sq;
+}
+
+
+/* plist_remove() takes square sq out of side c's piece list. */
+
+void plist_remove(pos_t *p, int c, int sq)
+{
+	int k;
+
+	for (k = 0; p->piece_list[c][k] != sq; ++k)
+		;
+	for (--p->piece_count[c]; k < p->piece_count[c]; ++k)
+		p->piece_list[c][k] = p->piece_list[c][k + 1];
+}
+
+
+/* plist_move() changes square from to square to in side c's piece
+   list, keeping the list in order. */
+
+void plist_move(pos_t *p, int c, int from, int to)
+{
+	int k;
+	unsigned char *l = p->piece_list[c];
+
+	for (k = 0; l[k] != from; ++k)
+		;
+	if (to > from)
+		for (; k + 1 < p->piece_count[c] && l[k + 1] < to; ++k)
+			l[k] = l[k + 1];
+	else
+		for (; k > 0 && l[k - 1] > to; --k)
+			l[k] = l[k - 1];
+	l[k] = to;
+}
+
+
+/* in_check(), attack(), gen_pseudo() and gen_caps() use the bitboard
+   code in bitboard.c if the program was built with BITBOARD defined
+   (see the Makefile), and the mailbox code below otherwise. */
+
+BOOL in_check(pos_t *p, int s)
+{
+#ifdef BITBOARD
+	return bb_in_check(p, s);
+#else
+	return mailbox_in_check(p, s);
+#endif
+}
+
+BOOL attack(pos_t *p, int sq, int s)
+{
+#ifdef BITBOARD
+	return bb_attack(p, sq, s);
+#else
+	return mailbox_attack(p, sq, s);
+#endif
+}
+
+void gen(pos_t *p)
+{
+	gen_pseudo(p);
+	gen_legal(p);
+}
+
+void gen_caps(pos_t *p)
+{
+#ifdef BITBOARD
+	bb_gen_caps(p);
+#else
+	mailbox_gen_caps(p);
+#endif
+	gen_legal(p);
+}
+
+
+/* gen_pseudo() generates the pseudo-legal moves that gen() starts
+   from (some of which may leave the king in check). */
+
+void gen_pseudo(pos_t *p)
+{
+#ifdef BITBOARD
+	bb_gen(p);
+#else
+	mailbox_gen(p);
+#endif
+}
+
+
+/* gen_legal() takes the illegal moves out of the current ply's move
+   list, keeping the rest in order, so gen() and gen_caps() only
+   generate legal moves and makemove() doesn't have to test them.
+   Rather than making each move to see if it leaves the king in check,
+   it looks out from the king once, for the pieces giving check and
+   the pieces pinned to it. Then a move other than the king's is legal
+   if it doesn't leave a pin's line and, when in check, if it captures
+   the checking piece or blocks it; a king move is legal if the
+   square it moves to isn't attacked once the king has left its old
+   square. Castling and en passant (which can uncover a check along
+   the rank of the two pawns) are rare enough to be tested the old
+   way, with move_legal(). */
+
+void gen_legal(pos_t *p)
+{
+	int i, j, k, n, pc, dir, king, last;
+	int checks = 0;
+	int pins = 0;
+	int pin_sq[8];
+	U64 pin_ray[8];
+	U64 pinned = 0;
+	U64 block = ~0ULL;  /* the squares that stop the check, if any */
+	U64 ray;
+	move_bytes m;
+
+	king = p->king_sq[p->side];
+	last = p->first_move[p->ply + 1];
+	if (king == -1) {  /* shouldn't get here */
+		for (i = k = p->first_move[p->ply]; i < last; ++i)
+			if (move_legal(p, p->gen_dat[i].m.b))
+				p->gen_dat[k++] = p->gen_dat[i];
+		p->first_move[p->ply + 1] = k;
+		return;
+	}
+
+	/* look along the king's lines for checking sliders, and for
+	   friendly pieces with an enemy slider behind them */
+	for (pc = BISHOP; pc <= ROOK; ++pc)
+		for (j = 0; j < offsets[pc]; ++j) {
+			ray = 0;
+			k = -1;
+			for (n = king;;) {
+				n = mailbox[mailbox64[n] + offset[pc][j]];
+				if (n == -1)
+					break;
+				ray |= 1ULL << n;
+				if (p->color[n] == EMPTY)
+					continue;
+				if (p->color[n] == p->side) {
+					if (k != -1)
+						break;
+					k = n;
+					continue;
 				}
-				else {
-					if (COL(i) != 0 && i + 7 == sq)
-						return TRUE;
-					if (COL(i) != 7 && i + 9 == sq)
-						return TRUE;
+				if (p->piece[n] == pc || p->piece[n] == QUEEN) {
+					if (k == -1)
+						block = checks++ ? 0 : ray;
+					else {
+						pin_sq[pins] = k;
+						pin_ray[pins++] = ray;
+						pinned |= 1ULL << k;
+					}
 				}
+				break;
+			}
+		}
+
+	/* knights and pawns give check from next to the king */
+	for (j = 0; j < offsets[KNIGHT]; ++j) {
+		n = mailbox[mailbox64[king] + offset[KNIGHT][j]];
+		if (n != -1 && p->color[n] == p->xside && p->piece[n] == KNIGHT)
+			block = checks++ ? 0 : 1ULL << n;
+	}
+	dir = p->side == LIGHT ? -1 : 1;
+	for (j = 9; j <= 11; j += 2) {
+		n = mailbox[mailbox64[king] + dir * j];
+		if (n != -1 && p->color[n] == p->xside && p->piece[n] == PAWN)
+			block = checks++ ? 0 : 1ULL << n;
+	}
+
+	for (i = k = p->first_move[p->ply]; i < last; ++i) {
+		m = p->gen_dat[i].m.b;
+		if (m.bits & 6) {
+			if (!move_legal(p, m))
+				continue;
+		}
+		else if (m.from == king) {
+			p->color[king] = EMPTY;
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->side, KING, king);
+#endif
+			n = attack(p, m.to, p->xside);
+			p->color[king] = p->side;
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->side, KING, king);
+#endif
+			if (n)
+				continue;
+		}
+		else {
+			if (!(block & (1ULL << m.to)))
+				continue;
+			if (pinned & (1ULL << m.from)) {
+				for (j = 0; pin_sq[j] != m.from; ++j)
+					;
+				if (!(pin_ray[j] & (1ULL << m.to)))
+					continue;
+			}
+		}
+		p->gen_dat[k++] = p->gen_dat[i];
+	}
+	p->first_move[p->ply + 1] = k;
+}
+
+
+/* move_legal() returns TRUE if pseudo-legal move m doesn't leave the
+   side to move in check, and (for castling) if the king isn't in
+   check, the squares between the king and rook are empty, and the
+   king doesn't pass through or land on an attacked square. It makes
+   and takes back the move to find out, so gen_legal() only uses it for
+   the moves it can't judge otherwise. */
+
+BOOL move_legal(pos_t *p, move_bytes m)
+{
+	BOOL legal;
+
+	if (m.bits & 2) {
+		if (in_check(p, p->side))
+			return FALSE;
+		switch (m.to) {
+			case 62:
+				return p->color[F1] == EMPTY && p->color[G1] == EMPTY &&
+						!attack(p, F1, p->xside) && !attack(p, G1, p->xside);
+			case 58:
+				return p->color[B1] == EMPTY && p->color[C1] == EMPTY &&
+						p->color[D1] == EMPTY &&
+						!attack(p, C1, p->xside) && !attack(p, D1, p->xside);
+			case 6:
+				return p->color[F8] == EMPTY && p->color[G8] == EMPTY &&
+						!attack(p, F8, p->xside) && !attack(p, G8, p->xside);
+			case 2:
+				return p->color[B8] == EMPTY && p->color[C8] == EMPTY &&
+						p->color[D8] == EMPTY &&
+						!attack(p, C8, p->xside) && !attack(p, D8, p->xside);
+			default:  /* shouldn't get here */
+				return FALSE;
+		}
+	}
+	makemove(p, m);
+	legal = !in_check(p, p->xside);
+	takeback(p);
+	return legal;
+}
+
+
+/* mailbox_in_check() returns TRUE if side s is in check and FALSE
+   otherwise. It just calls mailbox_attack() to see if side s's
+   king is being attacked. */
+
+BOOL mailbox_in_check(pos_t *p, int s)
+{
+	if (p->king_sq[s] == -1)
+		return TRUE;  /* shouldn't get here */
+	return mailbox_attack(p, p->king_sq[s], s ^ 1);
+}
+
+
+/* mailbox_attack() returns TRUE if square sq is being attacked by side
+   s and FALSE otherwise. */
+
+BOOL mailbox_attack(pos_t *p, int sq, int s)
+{
+	int i, j, k, n;
+
+	for (k = 0; k < p->piece_count[s]; ++k) {
+		i = p->piece_list[s][k];
+		if (p->piece[i] == PAWN) {
+			if (s == LIGHT) {
+				if (COL(i) != 0 && i - 9 == sq)
+					return TRUE;
+				if (COL(i) != 7 && i - 7 == sq)
+					return TRUE;
+			}
+			else {
+				if (COL(i) != 0 && i + 7 == sq)
+					return TRUE;
+				if (COL(i) != 7 && i + 9 == sq)
+					return TRUE;
 			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (n == sq)
-							return TRUE;
-						if (color[n] != EMPTY)
-							break;
-						if (!slide[piece[i]])
-							break;
-					}
 		}
+		else
+			for (j = 0; j < offsets[p->piece[i]]; ++j)
+				for (n = i;;) {
+					n = mailbox[mailbox64[n] + offset[p->piece[i]][j]];
+					if (n == -1)
+						break;
+					if (n == sq)
+						return TRUE;
+					if (p->color[n] != EMPTY)
+						break;
+					if (!slide[p->piece[i]])
+						break;
+				}
+	}
 	return FALSE;
 }
 
 
-/* gen() generates pseudo-legal moves for the current position.
+/* mailbox_gen() generates pseudo-legal moves for the current position.
    It scans the board to find friendly pieces and then determines
    what squares they attack. When it finds a piece/square
    combination, it calls gen_push to put the move on the "move
    stack." */
 
-void gen()
+void mailbox_gen(pos_t *p)
 {
-	int i, j, n;
+	int i, j, k, n;
 
 	/* so far, we have no moves for the current ply */
-	first_move[ply + 1] = first_move[ply];
+	p->first_move[p->ply + 1] = p->first_move[p->ply];
 
-	for (i = 0; i < 64; ++i)
-		if (color[i] == side) {
-			if (piece[i] == PAWN) {
-				if (side == LIGHT) {
-					if (COL(i) != 0 && color[i - 9] == DARK)
-						gen_push(i, i - 9, 17);
-					if (COL(i) != 7 && color[i - 7] == DARK)
-						gen_push(i, i - 7, 17);
-					if (color[i - 8] == EMPTY) {
-						gen_push(i, i - 8, 16);
-						if (i >= 48 && color[i - 16] == EMPTY)
-							gen_push(i, i - 16, 24);
-					}
+	for (k = 0; k < p->piece_count[p->side]; ++k) {
+		i = p->piece_list[p->side][k];
+		if (p->piece[i] == PAWN) {
+			if (p->side == LIGHT) {
+				if (COL(i) != 0 && p->color[i - 9] == DARK)
+					gen_push(p, i, i - 9, 17);
+				if (COL(i) != 7 && p->color[i - 7] == DARK)
+					gen_push(p, i, i - 7, 17);
+				if (p->color[i - 8] == EMPTY) {
+					gen_push(p, i, i - 8, 16);
+					if (i >= 48 && p->color[i - 16] == EMPTY)
+						gen_push(p, i, i - 16, 24);
 				}
-				else {
-					if (COL(i) != 0 && color[i + 7] == LIGHT)
-						gen_push(i, i + 7, 17);
-					if (COL(i) != 7 && color[i + 9] == LIGHT)
-						gen_push(i, i + 9, 17);
-					if (color[i + 8] == EMPTY) {
-						gen_push(i, i + 8, 16);
-						if (i <= 15 && color[i + 16] == EMPTY)
-							gen_push(i, i + 16, 24);
-					}
+			}
+			else {
+				if (COL(i) != 0 && p->color[i + 7] == LIGHT)
+					gen_push(p, i, i + 7, 17);
+				if (COL(i) != 7 && p->color[i + 9] == LIGHT)
+					gen_push(p, i, i + 9, 17);
+				if (p->color[i + 8] == EMPTY) {
+					gen_push(p, i, i + 8, 16);
+					if (i <= 15 && p->color[i + 16] == EMPTY)
+						gen_push(p, i, i + 16, 24);
 				}
 			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (color[n] != EMPTY) {
-							if (color[n] == xside)
-								gen_push(i, n, 1);
-							break;
-						}
-						gen_push(i, n, 0);
-						if (!slide[piece[i]])
-							break;
-					}
 		}
+		else
+			for (j = 0; j < offsets[p->piece[i]]; ++j)
+				for (n = i;;) {
+					n = mailbox[mailbox64[n] + offset[p->piece[i]][j]];
+					if (n == -1)
+						break;
+					if (p->color[n] != EMPTY) {
+						if (p->color[n] == p->xside)
+							gen_push(p, i, n, 1);
+						break;
+					}
+					gen_push(p, i, n, 0);
+					if (!slide[p->piece[i]])
+						break;
+				}
+	}
 
 	/* generate castle moves */
-	if (side == LIGHT) {
-		if (castle & 1)
-			gen_push(E1, G1, 2);
-		if (castle & 2)
-			gen_push(E1, C1, 2);
+	if (p->side == LIGHT) {
+		if (p->castle & 1)
+			gen_push(p, E1, G1, 2);
+		if (p->castle & 2)
+			gen_push(p, E1, C1, 2);
 	}
 	else {
-		if (castle & 4)
-			gen_push(E8, G8, 2);
-		if (castle & 8)
-			gen_push(E8, C8, 2);
+		if (p->castle & 4)
+			gen_push(p, E8, G8, 2);
+		if (p->castle & 8)
+			gen_push(p, E8, C8, 2);
 	}
 	
 	/* generate en passant moves */
-	if (ep != -1) {
-		if (side == LIGHT) {
-			if (COL(ep) != 0 && color[ep + 7] == LIGHT && piece[ep + 7] == PAWN)
-				gen_push(ep + 7, ep, 21);
-			if (COL(ep) != 7 && color[ep + 9] == LIGHT && piece[ep + 9] == PAWN)
-				gen_push(ep + 9, ep, 21);
+	if (p->ep != -1) {
+		if (p->side == LIGHT) {
+			if (COL(p->ep) != 0 && p->color[p->ep + 7] == LIGHT && p->piece[p->ep + 7] == PAWN)
+				gen_push(p, p->ep + 7, p->ep, 21);
+			if (COL(p->ep) != 7 && p->color[p->ep + 9] == LIGHT && p->piece[p->ep + 9] == PAWN)
+				gen_push(p, p->ep + 9, p->ep, 21);
 		}
 		else {
-			if (COL(ep) != 0 && color[ep - 9] == DARK && piece[ep - 9] == PAWN)
-				gen_push(ep - 9, ep, 21);
-			if (COL(ep) != 7 && color[ep - 7] == DARK && piece[ep - 7] == PAWN)
-				gen_push(ep - 7, ep, 21);
+			if (COL(p->ep) != 0 && p->color[p->ep - 9] == DARK && p->piece[p->ep - 9] == PAWN)
+				gen_push(p, p->ep - 9, p->ep, 21);
+			if (COL(p->ep) != 7 && p->color[p->ep - 7] == DARK && p->piece[p->ep - 7] == PAWN)
+				gen_push(p, p->ep - 7, p->ep, 21);
 		}
 	}
 }
 
 
-/* gen_caps() is basically a copy of gen() that's modified to
+/* mailbox_gen_caps() is basically a copy of mailbox_gen() that's modified to
    only generate capture and promote moves. It's used by the
    quiescence search. */
 
-void gen_caps()
+void mailbox_gen_caps(pos_t *p)
 {
-	int i, j, n;
+	int i, j, k, n;
 
-	first_move[ply + 1] = first_move[ply];
-	for (i = 0; i < 64; ++i)
-		if (color[i] == side) {
-			if (piece[i]==PAWN) {
-				if (side == LIGHT) {
-					if (COL(i) != 0 && color[i - 9] == DARK)
-						gen_push(i, i - 9, 17);
-					if (COL(i) != 7 && color[i - 7] == DARK)
-						gen_push(i, i - 7, 17);
-					if (i <= 15 && color[i - 8] == EMPTY)
-						gen_push(i, i - 8, 16);
-				}
-				if (side == DARK) {
-					if (COL(i) != 0 && color[i + 7] == LIGHT)
-						gen_push(i, i + 7, 17);
-					if (COL(i) != 7 && color[i + 9] == LIGHT)
-						gen_push(i, i + 9, 17);
-					if (i >= 48 && color[i + 8] == EMPTY)
-						gen_push(i, i + 8, 16);
-				}
+	p->first_move[p->ply + 1] = p->first_move[p->ply];
+	for (k = 0; k < p->piece_count[p->side]; ++k) {
+		i = p->piece_list[p->side][k];
+		if (p->piece[i]==PAWN) {
+			if (p->side == LIGHT) {
+				if (COL(i) != 0 && p->color[i - 9] == DARK)
+					gen_push(p, i, i - 9, 17);
+				if (COL(i) != 7 && p->color[i - 7] == DARK)
+					gen_push(p, i, i - 7, 17);
+				if (i <= 15 && p->color[i - 8] == EMPTY)
+					gen_push(p, i, i - 8, 16);
+			}
+			if (p->side == DARK) {
+				if (COL(i) != 0 && p->color[i + 7] == LIGHT)
+					gen_push(p, i, i + 7, 17);
+				if (COL(i) != 7 && p->color[i + 9] == LIGHT)
+					gen_push(p, i, i + 9, 17);
+				if (i >= 48 && p->color[i + 8] == EMPTY)
+					gen_push(p, i, i + 8, 16);
 			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (color[n] != EMPTY) {
-							if (color[n] == xside)
-								gen_push(i, n, 1);
-							break;
-						}
-						if (!slide[piece[i]])
-							break;
-					}
 		}
-	if (ep != -1) {
-		if (side == LIGHT) {
-			if (COL(ep) != 0 && color[ep + 7] == LIGHT && piece[ep + 7] == PAWN)
-				gen_push(ep + 7, ep, 21);
-			if (COL(ep) != 7 && color[ep + 9] == LIGHT && piece[ep + 9] == PAWN)
-				gen_push(ep + 9, ep, 21);
+		else
+			for (j = 0; j < offsets[p->piece[i]]; ++j)
+				for (n = i;;) {
+					n = mailbox[mailbox64[n] + offset[p->piece[i]][j]];
+					if (n == -1)
+						break;
+					if (p->color[n] != EMPTY) {
+						if (p->color[n] == p->xside)
+							gen_push(p, i, n, 1);
+						break;
+					}
+					if (!slide[p->piece[i]])
+						break;
+				}
+	}
+	if (p->ep != -1) {
+		if (p->side == LIGHT) {
+			if (COL(p->ep) != 0 && p->color[p->ep + 7] == LIGHT && p->piece[p->ep + 7] == PAWN)
+				gen_push(p, p->ep + 7, p->ep, 21);
+			if (COL(p->ep) != 7 && p->color[p->ep + 9] == LIGHT && p->piece[p->ep + 9] == PAWN)
+				gen_push(p, p->ep + 9, p->ep, 21);
 		}
 		else {
-			if (COL(ep) != 0 && color[ep - 9] == DARK && piece[ep - 9] == PAWN)
-				gen_push(ep - 9, ep, 21);
-			if (COL(ep) != 7 && color[ep - 7] == DARK && piece[ep - 7] == PAWN)
-				gen_push(ep - 7, ep, 21);
+			if (COL(p->ep) != 0 && p->color[p->ep - 9] == DARK && p->piece[p->ep - 9] == PAWN)
+				gen_push(p, p->ep - 9, p->ep, 21);
+			if (COL(p->ep) != 7 && p->color[p->ep - 7] == DARK && p->piece[p->ep - 7] == PAWN)
+				gen_push(p, p->ep - 7, p->ep, 21);
 		}
 	}
 }
@@ -314,46 +597,46 @@ void gen_caps()
    1,000,000 is added to a capture move's score, so it
    always gets ordered above a "normal" move. */
 
-void gen_push(int from, int to, int bits)
+void gen_push(pos_t *p, int from, int to, int bits)
 {
 	gen_t *g;
 	
 	if (bits & 16) {
-		if (side == LIGHT) {
+		if (p->side == LIGHT) {
 			if (to <= H8) {
-				gen_promote(from, to, bits);
+				gen_promote(p, from, to, bits);
 				return;
 			}
 		}
 		else {
 			if (to >= A1) {
-				gen_promote(from, to, bits);
+				gen_promote(p, from, to, bits);
 				return;
 			}
 		}
 	}
-	g = &gen_dat[first_move[ply + 1]++];
+	g = &p->gen_dat[p->first_move[p->ply + 1]++];
 	g->m.b.from = (char)from;
 	g->m.b.to = (char)to;
 	g->m.b.promote = 0;
 	g->m.b.bits = (char)bits;
-	if (color[to] != EMPTY)
-		g->score = 1000000 + (piece[to] * 10) - piece[from];
+	if (p->color[to] != EMPTY)
+		g->score = 1000000 + (p->piece[to] * 10) - p->piece[from];
 	else
-		g->score = history[from][to];
+		g->score = p->history[from][to];
 }
 
 
 /* gen_promote() is just like gen_push(), only it puts 4 moves
    on the move stack, one for each possible promotion piece */
 
-void gen_promote(int from, int to, int bits)
+void gen_promote(pos_t *p, int from, int to, int bits)
 {
 	int i;
 	gen_t *g;
 	
 	for (i = KNIGHT; i <= QUEEN; ++i) {
-		g = &gen_dat[first_move[ply + 1]++];
+		g = &p->gen_dat[p->first_move[p->ply + 1]++];
 		g->m.b.from = (char)from;
 		g->m.b.to = (char)to;
 		g->m.b.promote = (char)i;
@@ -363,148 +646,215 @@ void gen_promote(int from, int to, int bits)
 }
 
 
-/* makemove() makes a move. If the move is illegal, it
-   undoes whatever it did and returns FALSE. Otherwise, it
-   returns TRUE. */
+/* makemove() makes a move. The move must be legal (one of gen()'s or
+   gen_caps()'s); see gen_legal(). */
 
-BOOL makemove(move_bytes m)
+void makemove(pos_t *p, move_bytes m)
 {
-	
-	/* test to see if a castle move is legal and move the rook
-	   (the king is moved with the usual move code later) */
+	int piece;
+
+	/* the hash is backed up first, since moving a castling rook
+	   updates it */
+	p->hist_dat[p->hply].hash = p->hash;
+#ifdef COPY_MAKE
+	board_save(p, &p->board_dat[p->hply]);
+#endif
+
+	/* move the rook (the king is moved with the usual move code later) */
 	if (m.bits & 2) {
 		int from, to;
 
-		if (in_check(side))
-			return FALSE;
 		switch (m.to) {
 			case 62:
-				if (color[F1] != EMPTY || color[G1] != EMPTY ||
-						attack(F1, xside) || attack(G1, xside))
-					return FALSE;
 				from = H1;
 				to = F1;
 				break;
 			case 58:
-				if (color[B1] != EMPTY || color[C1] != EMPTY || color[D1] != EMPTY ||
-						attack(C1, xside) || attack(D1, xside))
-					return FALSE;
 				from = A1;
 				to = D1;
 				break;
 			case 6:
-				if (color[F8] != EMPTY || color[G8] != EMPTY ||
-						attack(F8, xside) || attack(G8, xside))
-					return FALSE;
 				from = H8;
 				to = F8;
 				break;
 			case 2:
-				if (color[B8] != EMPTY || color[C8] != EMPTY || color[D8] != EMPTY ||
-						attack(C8, xside) || attack(D8, xside))
-					return FALSE;
 				from = A8;
 				to = D8;
 				break;
 			default:  /* shouldn't get here */
-				from = -1;
-				to = -1;
-				break;
+				return;
 		}
-		color[to] = color[from];
-		piece[to] = piece[from];
-		color[from] = EMPTY;
-		piece[from] = EMPTY;
+		p->color[to] = p->color[from];
+		p->piece[to] = p->piece[from];
+		p->color[from] = EMPTY;
+		p->piece[from] = EMPTY;
+		plist_move(p, p->side, from, to);
+		p->hash ^= hash_piece[p->side][ROOK][from] ^ hash_piece[p->side][ROOK][to];
+#ifdef BITBOARD
+		BB_TOGGLE(p, p->side, ROOK, from);
+		BB_TOGGLE(p, p->side, ROOK, to);
+#endif
 	}
 
-	/* back up information so we can take the move back later. */
-	hist_dat[hply].m.b = m;
-	hist_dat[hply].capture = piece[(int)m.to];
-	hist_dat[hply].castle = castle;
-	hist_dat[hply].ep = ep;
-	hist_dat[hply].fifty = fifty;
-	hist_dat[hply].hash = hash;
-	++ply;
-	++hply;
+	/* back up information so we can take the move back later
+	   (copy-make only needs the move, for the history) */
+	p->hist_dat[p->hply].m.b = m;
+#ifndef COPY_MAKE
+	p->hist_dat[p->hply].capture = p->piece[(int)m.to];
+	p->hist_dat[p->hply].castle = p->castle;
+	p->hist_dat[p->hply].ep = p->ep;
+	p->hist_dat[p->hply].fifty = p->fifty;
+#endif
+	++p->ply;
+	++p->hply;
 
 	/* update the castle, en passant, and
 	   fifty-move-draw variables */
-	castle &= castle_mask[(int)m.from] & castle_mask[(int)m.to];
+	p->hash ^= hash_castle[p->castle];
+	p->castle &= castle_mask[(int)m.from] & castle_mask[(int)m.to];
+	p->hash ^= hash_castle[p->castle];
+	if (p->ep != -1)
+		p->hash ^= hash_ep[p->ep];
 	if (m.bits & 8) {
-		if (side == LIGHT)
-			ep = m.to + 8;
+		if (p->side == LIGHT)
+			p->ep = m.to + 8;
 		else
-			ep = m.to - 8;
+			p->ep = m.to - 8;
+		p->hash ^= hash_ep[p->ep];
 	}
 	else
-		ep = -1;
+		p->ep = -1;
 	if (m.bits & 17)
-		fifty = 0;
-	else
-		++fifty;
+		p->fifty = 0;
+	else if (p->fifty < 255)  /* it has to fit in a hist_t */
+		++p->fifty;
 
 	/* move the piece */
-	color[(int)m.to] = side;
+	if (p->color[(int)m.to] != EMPTY) {
+		plist_remove(p, p->xside, m.to);
+		p->hash ^= hash_piece[p->xside][p->piece[(int)m.to]][(int)m.to];
+		if (p->piece[(int)m.to] == PAWN)
+			p->pawn_hash ^= hash_piece[p->xside][PAWN][(int)m.to];
+	}
+	plist_move(p, p->side, m.from, m.to);
+	piece = (m.bits & 32) ? m.promote : p->piece[(int)m.from];
+	p->hash ^= hash_piece[p->side][p->piece[(int)m.from]][(int)m.from] ^
+			hash_piece[p->side][piece][(int)m.to];
+	if (p->piece[(int)m.from] == PAWN)
+		p->pawn_hash ^= hash_piece[p->side][PAWN][(int)m.from];
+	if (piece == PAWN)
+		p->pawn_hash ^= hash_piece[p->side][PAWN][(int)m.to];
+	if (p->piece[(int)m.from] == KING)
+		p->king_sq[p->side] = m.to;
+#ifdef BITBOARD
+	if (p->color[(int)m.to] != EMPTY)
+		BB_TOGGLE(p, p->xside, p->piece[(int)m.to], (int)m.to);
+	BB_TOGGLE(p, p->side, p->piece[(int)m.from], (int)m.from);
+	BB_TOGGLE(p, p->side, (m.bits & 32) ? m.promote : p->piece[(int)m.from],
+			(int)m.to);
+#endif
+	p->color[(int)m.to] = p->side;
 	if (m.bits & 32)
-		piece[(int)m.to] = m.promote;
+		p->piece[(int)m.to] = m.promote;
 	else
-		piece[(int)m.to] = piece[(int)m.from];
-	color[(int)m.from] = EMPTY;
-	piece[(int)m.from] = EMPTY;
+		p->piece[(int)m.to] = p->piece[(int)m.from];
+	p->color[(int)m.from] = EMPTY;
+	p->piece[(int)m.from] = EMPTY;
 
 	/* erase the pawn if this is an en passant move */
 	if (m.bits & 4) {
-		if (side == LIGHT) {
-			color[m.to + 8] = EMPTY;
-			piece[m.to + 8] = EMPTY;
+		if (p->side == LIGHT) {
+			p->color[m.to + 8] = EMPTY;
+			p->piece[m.to + 8] = EMPTY;
+			plist_remove(p, p->xside, m.to + 8);
+			p->hash ^= hash_piece[p->xside][PAWN][m.to + 8];
+			p->pawn_hash ^= hash_piece[p->xside][PAWN][m.to + 8];
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->xside, PAWN, m.to + 8);
+#endif
 		}
 		else {
-			color[m.to - 8] = EMPTY;
-			piece[m.to - 8] = EMPTY;
+			p->color[m.to - 8] = EMPTY;
+			p->piece[m.to - 8] = EMPTY;
+			plist_remove(p, p->xside, m.to - 8);
+			p->hash ^= hash_piece[p->xside][PAWN][m.to - 8];
+			p->pawn_hash ^= hash_piece[p->xside][PAWN][m.to - 8];
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->xside, PAWN, m.to - 8);
+#endif
 		}
 	}
 
-	/* switch sides and test for legality (if we can capture
-	   the other guy's king, it's an illegal position and
-	   we need to take the move back) */
-	side ^= 1;
-	xside ^= 1;
-	if (in_check(xside)) {
-		takeback();
-		return FALSE;
-	}
-	set_hash();
-	return TRUE;
+	/* switch sides */
+	p->side ^= 1;
+	p->xside ^= 1;
+	p->hash ^= hash_side;
 }
 
 
-/* takeback() is very similar to makemove(), only backwards :)  */
+/* takeback() is very similar to makemove(), only backwards :)
+   Built with COPY_MAKE, it just loads the board makemove() saved. */
+
+#ifdef COPY_MAKE
 
-void takeback()
+void takeback(pos_t *p)
+{
+	--p->ply;
+	--p->hply;
+	board_load(p, &p->board_dat[p->hply]);
+}
+
+#else
+
+void takeback(pos_t *p)
 {
 	move_bytes m;
 
-	side ^= 1;
-	xside ^= 1;
-	--ply;
-	--hply;
-	m = hist_dat[hply].m.b;
-	castle = hist_dat[hply].castle;
-	ep = hist_dat[hply].ep;
-	fifty = hist_dat[hply].fifty;
-	hash = hist_dat[hply].hash;
-	color[(int)m.from] = side;
+	p->side ^= 1;
+	p->xside ^= 1;
+	--p->ply;
+	--p->hply;
+	m = p->hist_dat[p->hply].m.b;
+	p->castle = p->hist_dat[p->hply].castle;
+	p->ep = p->hist_dat[p->hply].ep;
+	p->fifty = p->hist_dat[p->hply].fifty;
+	p->hash = p->hist_dat[p->hply].hash;
+
+	/* pawn_hash isn't backed up, so its changes are undone */
+	if (p->piece[(int)m.to] == PAWN)
+		p->pawn_hash ^= hash_piece[p->side][PAWN][(int)m.to];
+	if (p->piece[(int)m.to] == PAWN || (m.bits & 32))
+		p->pawn_hash ^= hash_piece[p->side][PAWN][(int)m.from];
+	if (p->hist_dat[p->hply].capture == PAWN)
+		p->pawn_hash ^= hash_piece[p->xside][PAWN][(int)m.to];
+	if (m.bits & 4)
+		p->pawn_hash ^= hash_piece[p->xside][PAWN][
+				p->side == LIGHT ? m.to + 8 : m.to - 8];
+
+	plist_move(p, p->side, m.to, m.from);
+	if (p->piece[(int)m.to] == KING)
+		p->king_sq[p->side] = m.from;
+	if (p->hist_dat[p->hply].capture != EMPTY)
+		plist_add(p, p->xside, m.to);
+#ifdef BITBOARD
+	BB_TOGGLE(p, p->side, p->piece[(int)m.to], (int)m.to);
+	BB_TOGGLE(p, p->side, (m.bits & 32) ? PAWN : p->piece[(int)m.to],
+			(int)m.from);
+	if (p->hist_dat[p->hply].capture != EMPTY)
+		BB_TOGGLE(p, p->xside, (int)p->hist_dat[p->hply].capture, (int)m.to);
+#endif
+	p->color[(int)m.from] = p->side;
 	if (m.bits & 32)
-		piece[(int)m.from] = PAWN;
+		p->piece[(int)m.from] = PAWN;
 	else
-		piece[(int)m.from] = piece[(int)m.to];
-	if (hist_dat[hply].capture == EMPTY) {
-		color[(int)m.to] = EMPTY;
-		piece[(int)m.to] = EMPTY;
+		p->piece[(int)m.from] = p->piece[(int)m.to];
+	if (p->hist_dat[p->hply].capture == EMPTY) {
+		p->color[(int)m.to] = EMPTY;
+		p->piece[(int)m.to] = EMPTY;
 	}
 	else {
-		color[(int)m.to] = xside;
-		piece[(int)m.to] = hist_dat[hply].capture;
+		p->color[(int)m.to] = p->xside;
+		p->piece[(int)m.to] = p->hist_dat[p->hply].capture;
 	}
 	if (m.bits & 2) {
 		int from, to;
@@ -527,23 +877,172 @@ void takeback()
 				to = A8;
 				break;
 			default:  /* shouldn't get here */
-				from = -1;
-				to = -1;
-				break;
+				return;
 		}
-		color[to] = side;
-		piece[to] = ROOK;
-		color[from] = EMPTY;
-		piece[from] = EMPTY;
+		p->color[to] = p->side;
+		p->piece[to] = ROOK;
+		p->color[from] = EMPTY;
+		p->piece[from] = EMPTY;
+		plist_move(p, p->side, from, to);
+#ifdef BITBOARD
+		BB_TOGGLE(p, p->side, ROOK, from);
+		BB_TOGGLE(p, p->side, ROOK, to);
+#endif
 	}
 	if (m.bits & 4) {
-		if (side == LIGHT) {
-			color[m.to + 8] = xside;
-			piece[m.to + 8] = PAWN;
+		if (p->side == LIGHT) {
+			p->color[m.to + 8] = p->xside;
+			p->piece[m.to + 8] = PAWN;
+			plist_add(p, p->xside, m.to + 8);
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->xside, PAWN, m.to + 8);
+#endif
 		}
 		else {
-			color[m.to - 8] = xside;
-			piece[m.to - 8] = PAWN;
+			p->color[m.to - 8] = p->xside;
+			p->piece[m.to - 8] = PAWN;
+			plist_add(p, p->xside, m.to - 8);
+#ifdef BITBOARD
+			BB_TOGGLE(p, p->xside, PAWN, m.to - 8);
+#endif
+		}
+	}
+}
+
+
+#endif
+
+
+#ifdef COPY_MAKE
+
+/* board_save() packs position p's board into b. */
+
+void board_save(pos_t *p, board_t *b)
+{
+	int i;
+
+	for (i = 0; i < 64; ++i)
+		b->sq[i] = (unsigned char)(p->color[i] << 4 | p->piece[i]);
+	memcpy(b->piece_list, p->piece_list, sizeof(b->piece_list));
+	b->piece_count[LIGHT] = (signed char)p->piece_count[LIGHT];
+	b->piece_count[DARK] = (signed char)p->piece_count[DARK];
+	b->king_sq[LIGHT] = (signed char)p->king_sq[LIGHT];
+	b->king_sq[DARK] = (signed char)p->king_sq[DARK];
+	b->side = (signed char)p->side;
+	b->castle = (signed char)p->castle;
+	b->ep = (signed char)p->ep;
+	b->fifty = (unsigned char)p->fifty;
+	b->hash = p->hash;
+	b->pawn_hash = p->pawn_hash;
+#ifdef BITBOARD
+	memcpy(b->bb, p->bb, sizeof(b->bb));
+	b->bb_side[LIGHT] = p->bb_side[LIGHT];
+	b->bb_side[DARK] = p->bb_side[DARK];
+#endif
+}
+
+
+/* board_load() sets position p's board from b. */
+
+void board_load(pos_t *p, board_t *b)
+{
+	int i;
+
+	for (i = 0; i < 64; ++i) {
+		p->color[i] = b->sq[i] >> 4;
+		p->piece[i] = b->sq[i] & 15;
+	}
+	memcpy(p->piece_list, b->piece_list, sizeof(p->piece_list));
+	p->piece_count[LIGHT] = b->piece_count[LIGHT];
+	p->piece_count[DARK] = b->piece_count[DARK];
+	p->king_sq[LIGHT] = b->king_sq[LIGHT];
+	p->king_sq[DARK] = b->king_sq[DARK];
+	p->side = b->side;
+	p->xside = b->side ^ 1;
+	p->castle = b->castle;
+	p->ep = b->ep;
+	p->fifty = b->fifty;
+	p->hash = b->hash;
+	p->pawn_hash = b->pawn_hash;
+#ifdef BITBOARD
+	memcpy(p->bb, b->bb, sizeof(p->bb));
+	p->bb_side[LIGHT] = b->bb_side[LIGHT];
+	p->bb_side[DARK] = b->bb_side[DARK];
+#endif
+}
+
+#endif
+
+
+/* pos_copy() copies position from, with its game history, to position
+   to, so another thread can search it. The move lists and the PV
+   aren't copied. */
+
+void pos_copy(pos_t *to, pos_t *from)
+{
+	memcpy(to->color, from->color, sizeof(from->color));
+	memcpy(to->piece, from->piece, sizeof(from->piece));
+	to->side = from->side;
+	to->xside = from->xside;
+	to->castle = from->castle;
+	to->ep = from->ep;
+	to->fifty = from->fifty;
+	to->hash = from->hash;
+	to->pawn_hash = from->pawn_hash;
+	to->ply = from->ply;
+	to->hply = from->hply;
+	memcpy(to->first_move, from->first_move,
+			(from->ply + 1) * sizeof(from->first_move[0]));
+	memcpy(to->hist_dat, from->hist_dat,
+			from->hply * sizeof(from->hist_dat[0]));
+	to->follow_pv = FALSE;
+	plist_set(to);
+}
+
+
+/* perft() returns the number of positions depth ply from p (the leaves
+   of the tree of legal moves), which can be compared with the known
+   counts for a position to test the move generator. */
+
+U64 perft(pos_t *p, int depth)
+{
+	int i;
+	U64 n = 0;
+
+	gen(p);
+	if (depth <= 1)
+		return depth <= 0 ? 1 : p->first_move[p->ply + 1] - p->first_move[p->ply];
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		makemove(p, p->gen_dat[i].m.b);
+		n += perft(p, depth - 1);
+		takeback(p);
+	}
+	return n;
+}
+
+
+/* perft_pseudo() is perft() done the old way, by making every
+   pseudo-legal move and testing it with move_legal(). The two should
+   always agree. */
+
+U64 perft_pseudo(pos_t *p, int depth)
+{
+	int i;
+	U64 n = 0;
+
+	if (depth <= 0)
+		return 1;
+	gen_pseudo(p);
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		if (!move_legal(p, p->gen_dat[i].m.b))
+			continue;
+		if (depth == 1) {
+			++n;
+			continue;
 		}
+		makemove(p, p->gen_dat[i].m.b);
+		n += perft_pseudo(p, depth - 1);
+		takeback(p);
 	}
+	return n;
 }
@@ -11,69 +11,77 @@
 #include <string.h>
 
 /* serial/parallel switches for different functions */
-int (*eval_func)();
-int (*quiesce_func)(int, int);
-int (*search_func)(int, int, int);
+int (*eval_func)(pos_t *);
+int (*quiesce_func)(pos_t *, int, int);
+int (*search_func)(pos_t *, int, int, int);
+void (*iterate_func)(pos_t *, int);
 
 int threads;
 
-/* the board representation */
-int color[64];  /* LIGHT, DARK, or EMPTY */
-int piece[64];  /* PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, or EMPTY */
-int side;  /* the side to move */
-int xside;  /* the side not to move */
-int castle;  /* a bitfield with the castle permissions. if 1 is set,
-                white can still castle kingside. 2 is white queenside.
-				4 is black kingside. 8 is black queenside. */
-int ep;  /* the en passant square. if white moves e2e4, the en passant
-            square is set to e3, because that's where a pawn would move
-			in an en passant capture */
-int fifty;  /* the number of moves since a capture or pawn move, used
-               to handle the fifty-move-draw rule */
-int hash;  /* a (more or less) unique number that corresponds to the
-              position */
-int ply;  /* the number of half-moves (ply) since the
-             root of the search tree */
-int hply;  /* h for history; the number of ply since the beginning
-              of the game */
-			  
-/* gen_dat is some memory for move lists that are created by the move
-   generators. The move list for ply n starts at first_move[n] and ends
-   at first_move[n + 1]. */
-gen_t gen_dat[GEN_STACK];
-int first_move[MAX_PLY];
-
-/* the history heuristic array (used for move ordering) */
-int history[64][64];
-
-/* we need an array of hist_t's so we can take back the
-   moves we make */
-hist_t hist_dat[HIST_STACK];
+/* the number of worker processes for mp_search(); see mp.c */
+int procs;
+
+/* the number of workers connected for net_search(); see net.c */
+int net_workers;
+
+/* the positions the search threads work on. pos_dat[0] is the
+   game's position, which the main thread searches; each helper thread
+   copies the root position into its own when a search starts. */
+pos_t pos_dat[MAX_THREADS];
+
+/* the machine's NUMA layout (see numa.c): search thread n runs on
+   processor numa_cpu[n], which is on node numa_node[n] */
+int numa_nodes;  /* nodes with processors on them */
+int numa_size;  /* processors we know the node of */
+int numa_cpu[MAX_THREADS];
+int numa_node[MAX_THREADS];
+flag_t numa_pool;  /* are the pool's threads the pinned ones? */
+
+/* set when the search should stop, by the timer thread (see timer.c)
+   or a search function. every thread polls it at every node, so it
+   gets a cache line to itself. */
+flag_t stop_search;
+
+/* how many microseconds it took the last search to stop once time
+   was up, or -1 if it finished before then */
+int stop_latency = -1;
+
+/* the score of the last search's last finished iteration */
+int search_score;
+
+/* the split granularity: a node may only be split if it has at least
+   split_depth ply left and split_moves moves left to search, and those
+   moves are expected to take at least split_nodes nodes. split_size[d]
+   is a running average of how many nodes a move takes at a node with
+   d ply left. See split_ok() in search.c; "bench tune" picks the
+   thresholds for the machine it's run on. */
+int split_depth = 3;
+int split_moves = 2;
+int split_nodes = 500;
+int split_size[MAX_PLY];
 
 /* the engine will search for max_time milliseconds or until it finishes
    searching max_depth ply. */
 int max_time;
 int max_depth;
 
-/* the time when the engine starts searching, and when it should stop */
+/* the time when the engine starts searching */
 int start_time;
-int stop_time;
-
-int nodes;  /* the number of nodes we've searched */
-
-/* a "triangular" PV array; for a good explanation of why a triangular
-   array is needed, see "How Computers Play Chess" by Levy and Newborn. */
-move pv[MAX_PLY][MAX_PLY];
-int pv_length[MAX_PLY];
-BOOL follow_pv;
-
-move best_pv[MAX_PLY]; // for parallel quiescence
-int best_pv_length;
 
 /* random numbers used to compute hash; see set_hash() in board.c */
-int hash_piece[2][6][64];  /* indexed by piece [color][type][square] */
-int hash_side;
-int hash_ep[64];
+U64 hash_piece[2][6][64];  /* indexed by piece [color][type][square] */
+U64 hash_side;
+U64 hash_ep[64];
+U64 hash_castle[16];  /* indexed by the castle permissions */
+U64 hash_seed;  /* hash_rand()'s state */
+
+/* the transposition table, shared by all threads. it has tt_size
+   buckets of TT_BUCKET entries each; tt_size is a power of 2, so
+   hash & (tt_size - 1) picks a position's bucket. tt_age is bumped
+   every search so entries from old searches can be replaced first. */
+tt_entry *tt;
+int tt_size;
+int tt_age;
 
 /* Now we have the mailbox array, so called because it looks like a
    mailbox, at least according to Bob Hyatt. This is useful when we
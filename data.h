@@ -12,46 +12,46 @@
 /* this is basically a copy of data.c that's included by most
    of the source files so they can use the data.c variables */
 
-extern int (*eval_func)();
-extern int (*quiesce_func)(int, int);
-extern int (*search_func)(int, int, int);
+extern int (*eval_func)(pos_t *);
+extern int (*quiesce_func)(pos_t *, int, int);
+extern int (*search_func)(pos_t *, int, int, int);
+extern void (*iterate_func)(pos_t *, int);
 
 extern int threads;
+extern int procs;
+extern int net_workers;
    
-extern int color[64];
-extern int piece[64];
+extern pos_t pos_dat[MAX_THREADS];
 
-extern int side;
-extern int xside;
-extern int castle;
-extern int ep;
-extern int fifty;
-extern int hash;
-extern int ply;
-extern int hply;
+extern int numa_nodes;
+extern int numa_size;
+extern int numa_cpu[MAX_THREADS];
+extern int numa_node[MAX_THREADS];
+extern flag_t numa_pool;
 
-extern gen_t gen_dat[GEN_STACK];
-extern int first_move[MAX_PLY];
 
-extern int history[64][64];
-extern hist_t hist_dat[HIST_STACK];
+extern flag_t stop_search;
+
+extern int split_depth;
+extern int split_moves;
+extern int split_nodes;
+extern int split_size[MAX_PLY];
 
 extern int max_time;
 extern int max_depth;
 extern int start_time;
-extern int stop_time;
-extern int nodes;
-
-extern move pv[MAX_PLY][MAX_PLY];
-extern int pv_length[MAX_PLY];
-extern BOOL follow_pv;
+extern int stop_latency;
+extern int search_score;
 
-extern move best_pv[MAX_PLY];
-extern int best_pv_length;
+extern U64 hash_piece[2][6][64];
+extern U64 hash_side;
+extern U64 hash_ep[64];
+extern U64 hash_castle[16];
+extern U64 hash_seed;
 
-extern int hash_piece[2][6][64];
-extern int hash_side;
-extern int hash_ep[64];
+extern tt_entry *tt;
+extern int tt_size;
+extern int tt_age;
 
 extern int mailbox[120];
 extern int mailbox64[64];
@@ -12,9 +12,17 @@
 #define TRUE			1
 #define FALSE			0
 
+typedef unsigned long long U64;
+
+/* simple spinlocks, for data shared by the parallel search functions */
+#define LOCK(x)			while (__sync_lock_test_and_set(&(x), 1)) while (x)
+#define UNLOCK(x)		__sync_lock_release(&(x))
+
 #define GEN_STACK		1120
 #define MAX_PLY			32
 #define HIST_STACK		400
+#define MAX_THREADS		64
+#define CACHE_LINE		64  /* bytes */
 
 #define LIGHT			0
 #define DARK			1
@@ -84,15 +92,313 @@ typedef struct {
 	int score;
 } gen_t;
 
+/* an int with a cache line to itself. Flags and counters that threads
+   poll while other threads write nearby data (or the other way around)
+   go in these, so the line they're on isn't passed back and forth
+   between processors for nothing. */
+typedef struct {
+	volatile int val;
+	char pad[CACHE_LINE - sizeof(int)];
+} __attribute__((aligned(CACHE_LINE))) flag_t;
+
 /* an element of the history stack, with the information
-   necessary to take a move back. */
+   necessary to take a move back. The fields are bytes so that an
+   element is 16 bytes, since the stack is copied to other threads;
+   makemove() never lets fifty go past 255. */
 typedef struct {
 	move m;
-	int capture;
+	signed char capture;
+	signed char castle;
+	signed char ep;  /* -1 if none, so it has to be signed */
+	unsigned char fifty;
+	U64 hash;
+} hist_t;
+
+#ifdef COPY_MAKE
+/* a position's board, packed into 120 bytes (232 with BITBOARD) for
+   copy-make: makemove() saves one before each move, and takeback()
+   loads it back instead of undoing the move (see board.c). sq[n] is
+   square n's color times 16 plus its piece. */
+typedef struct {
+	unsigned char sq[64];
+	unsigned char piece_list[2][16];
+	signed char piece_count[2];
+	signed char king_sq[2];
+	signed char side;
+	signed char castle;
+	signed char ep;
+	unsigned char fifty;
+	U64 hash;
+	U64 pawn_hash;
+#ifdef BITBOARD
+	U64 bb[2][6];
+	U64 bb_side[2];
+#endif
+} board_t;
+#endif
+
+/* an element of the transposition table. data packs the best move,
+   score, depth, bound type and age of a search result; key is the
+   position's hash XORed with data, so that a probe can tell if another
+   thread's store was interleaved with its own (the "lockless hashing"
+   trick from Hyatt and Mann). That lets all threads share the table
+   without locking it. */
+typedef struct {
+	U64 key;
+	U64 data;
+} tt_entry;
+
+/* number of entries in a thread's local table (see tt.c), a power of 2.
+   at 16 bytes an entry, it's small enough to stay in a core's L2 cache. */
+#define TT_LOCAL_SIZE	8192
+
+#ifdef BITBOARD
+/* adds or removes piece pc of color c on square sq of position p's
+   bitboards */
+#define BB_TOGGLE(p, c, pc, sq)	((p)->bb[c][pc] ^= 1ULL << (sq), \
+		(p)->bb_side[c] ^= 1ULL << (sq))
+#endif
+
+/* a slider's attack table for one square (see bitboard.c). The
+   squares in mask that are occupied pick an entry of attacks, either
+   by multiplying by magic and keeping the top bits, or with PEXT. */
+typedef struct {
+	U64 mask;
+	U64 magic;
+	U64 *attacks;
+	int shift;
+} bb_magic;
+
+/* a position and the search state that goes with it. Each search
+   thread has its own (see pos_dat in data.c), and every function that
+   looks at the board or searches is passed the one it should use. */
+typedef struct {
+	/* the board is kept in bytes, since it's copied whenever a thread
+	   joins a split point */
+	unsigned char color[64];  /* LIGHT, DARK, or EMPTY */
+	unsigned char piece[64];  /* PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, or EMPTY */
+
+	/* the squares each side has pieces on, in order, so loops over the
+	   pieces don't have to look at every square, and where each side's
+	   king is (-1 if it doesn't have one) */
+	unsigned char piece_list[2][16];
+	int piece_count[2];
+	int king_sq[2];
+	int side;  /* the side to move */
+	int xside;  /* the side not to move */
+	int castle;  /* a bitfield with the castle permissions. if 1 is set,
+	                white can still castle kingside. 2 is white queenside.
+	                4 is black kingside. 8 is black queenside. */
+	int ep;  /* the en passant square. if white moves e2e4, the en passant
+	            square is set to e3, because that's where a pawn would move
+	            in an en passant capture */
+	int fifty;  /* the number of moves since a capture or pawn move, used
+	               to handle the fifty-move-draw rule */
+	U64 hash;  /* a (more or less) unique number that corresponds to the
+	              position */
+	U64 pawn_hash;  /* the same for just the pawns */
+	int ply;  /* the number of half-moves (ply) since the
+	             root of the search tree */
+	int hply;  /* h for history; the number of ply since the beginning
+	              of the game */
+
+	/* gen_dat is some memory for move lists that are created by the move
+	   generators. The move list for ply n starts at first_move[n] and ends
+	   at first_move[n + 1]. */
+	gen_t gen_dat[GEN_STACK];
+	int first_move[MAX_PLY];
+
+	/* we need an array of hist_t's so we can take back the
+	   moves we make */
+	hist_t hist_dat[HIST_STACK];
+#ifdef COPY_MAKE
+	board_t board_dat[HIST_STACK];  /* the board before each move */
+#endif
+
+	/* a "triangular" PV array; for a good explanation of why a triangular
+	   array is needed, see "How Computers Play Chess" by Levy and Newborn. */
+	move pv[MAX_PLY][MAX_PLY];
+	int pv_length[MAX_PLY];
+	BOOL follow_pv;
+
+	/* the thread's own history heuristic array (used for move ordering).
+	   the threads' arrays are merged between iterations; see
+	   history_merge() in search.c. */
+	int history[64][64];
+
+	int id;  /* the thread's index in pos_dat */
+	struct split_s *split;  /* the split point the thread is working under */
+	int nodes;  /* the number of nodes this thread has searched */
+
+#ifdef BITBOARD
+	/* the board again as bitboards (see bitboard.c): bit n of
+	   bb[c][p] is set if there's a piece p of color c on square n */
+	U64 bb[2][6];
+	U64 bb_side[2];  /* all of a color's pieces */
+#endif
+
+	/* the thread's local transposition table, which caches its recent
+	   probes of the shared one, and its probe counts for this search */
+	tt_entry tt_local[TT_LOCAL_SIZE];
+	int tt_probes;
+	int tt_local_hits;
+	int tt_hits;  /* hits in the shared table */
+} __attribute__((aligned(CACHE_LINE))) pos_t;
+
+/* what eval() learns about the pawns and material in its first pass.
+   pawn_rank[x][y] is the rank of the least advanced pawn of color x on file
+   y - 1. There are "buffer files" on the left and right to avoid special-case
+   logic later. If there's no pawn on a rank, we pretend the pawn is
+   impossibly far advanced (0 for LIGHT and 7 for DARK). This makes it easy to
+   test for pawns on a rank and it simplifies some pawn evaluation code. */
+typedef struct {
+	int pawn_rank[2][10];
+	int piece_mat[2];  /* the value of a side's pieces */
+	int pawn_mat[2];  /* the value of a side's pawns */
+} eval_t;
+
+/* number of entries in a transposition table bucket. a store may
+   replace any entry in its bucket. */
+#define TT_BUCKET		4
+
+/* transposition table bound types */
+#define TT_EXACT		1
+#define TT_UPPER		2  /* score is at most the stored score (failed low) */
+#define TT_LOWER		3  /* score is at least the stored score (failed high) */
+
+/* a thread's result at a split point: the best move it found there,
+   and the PV that goes with it */
+typedef struct {
+	move best;
+	move pv[MAX_PLY];
+	int pv_length;
+} __attribute__((aligned(CACHE_LINE))) split_slot;
+
+/* a split point's bound packs its alpha with the id of the thread whose
+   slot has the result that goes with it, so both can be updated with
+   one compare-and-swap. Bounds compare like their alphas. */
+#define SPLIT_BOUND(a, id)	((U64)((a) + 32768) << 32 | (id))
+#define SPLIT_ALPHA(b)		((int)((b) >> 32) - 32768)
+#define SPLIT_ID(b)			((int)((b) & 0xffffffff))
+
+/* a split point for the YBWC search: a node whose first move has been
+   searched, so that its remaining moves can be searched by any thread
+   that's idle. Each thread that joins copies the position from here,
+   takes the next unsearched move under the lock, and merges its result
+   into bound without locking (see split_merge()). Split points form a
+   tree (parent is the split point the owner was itself working under),
+   so a cutoff at one stops every thread working below it. */
+typedef struct split_s {
+	struct split_s *parent;
+	volatile int lock;
+	volatile BOOL active;  /* can threads join? */
+	volatile BOOL cutoff;  /* did a move fail high? */
+	volatile U64 bound;  /* alpha, and whose result it is */
+	int beta;
+	int depth;
+	volatile int next;  /* the next move to be searched */
+	int last;
+	volatile int workers;  /* threads searching moves here */
+	gen_t *moves;  /* the owner's move list */
+	split_slot slot[MAX_THREADS];  /* indexed by pos_t id */
+
+	/* the position at the split point. hist has the owner's hist_dat
+	   entries from the root of the search to here, so helpers can
+	   detect repetitions, and DTS can replay the moves from the root */
+	unsigned char color[64];
+	unsigned char piece[64];
+	int side;
+	int xside;
 	int castle;
 	int ep;
 	int fifty;
-	int hash;
-} hist_t;
+	U64 hash;
+	U64 pawn_hash;
+	int ply;
+	int hply;
+	int first_move;
+	hist_t hist[MAX_PLY];
+} split_t;
+
+/* a task for the thread pool: search move i of split point sp. stolen
+   tells func whether it's running on a thread other than the one that
+   made the split point. */
+typedef struct {
+	void (*func)(pos_t *p, split_t *sp, int i, BOOL stolen);
+	split_t *sp;
+	int i;
+} task_t;
+
+/* a pool thread's deque of tasks. The thread pushes and pops tasks at
+   the tail, and other threads steal them from the head. Every task on
+   a thread's deque is for a different move in its gen_dat, so it can
+   never hold more than GEN_STACK of them. */
+typedef struct {
+	volatile int lock;
+	int head;
+	int tail;
+	task_t task[GEN_STACK];
+} deque_t;
+
+/* a node on a DTS thread's search stack. The stack lives in shared
+   memory, so that while its thread is paused an idle thread can turn
+   any node on it into a split point. */
+typedef struct {
+	int state;  /* DTS_FREE, DTS_ENTER, DTS_NEXT, or DTS_WAIT */
+	int alpha;
+	int beta;
+	int depth;
+	int next;  /* the next move in the thread's gen_dat to search */
+	int last;
+	int searched;  /* number of moves that have been searched */
+	BOOL check;
+	BOOL legal;
+	BOOL base;  /* is this where the thread joined a split point? */
+	move cur;  /* the move being searched */
+	move best;
+	split_t *sp;  /* the split point at this node, if there is one */
+	split_t *under;  /* the split point this node is searched under */
+} dts_frame;
+
+/* a DTS thread's search state. An idle thread sets pause to 1 and
+   waits for the thread to set it to 2 before looking at its stack;
+   the thread waits for pause to go back to 0 before going on. */
+typedef struct {
+	volatile int lock;  /* held by the thread that's pausing this one */
+	volatile int pause;
+	volatile BOOL busy;
+	int top;  /* ply of the topmost node on the stack */
+	pos_t *pos;  /* the position the thread searches */
+	dts_frame frame[MAX_PLY];
+} dts_thread;
+
+/* a root move for a worker process to search (see mp.c). On the pipe,
+   it's followed by the position's hply hist_t's, so the worker can
+   detect repetitions. */
+typedef struct {
+	unsigned char color[64];
+	unsigned char piece[64];
+	int side;
+	int xside;
+	int castle;
+	int ep;
+	int fifty;
+	int hply;
+	move m;
+	int alpha;
+	int beta;
+	int depth;
+	int age;  /* the coordinator's tt_age */
+	int ms;  /* how long the worker has to search */
+} mp_job;
+
+/* a worker process's result for an mp_job */
+typedef struct {
+	BOOL stopped;  /* did time run out? then score means nothing */
+	int score;
+	int nodes;
+	int pv_length;  /* the number of PV moves after the job's move */
+	move pv[MAX_PLY];
+} mp_result;
 
 #endif /* DEFS_H */
@@ -0,0 +1,642 @@
+/*
+ *	DTS.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <string.h>
+#include <omp.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This is a Dynamic Tree Splitting search (after Hyatt's DTS for Cray
+   Blitz). Instead of recursing like search(), dts_run() keeps the nodes
+   it's searching on an explicit stack in shared memory. An idle thread
+   can then pause any busy thread, look over its stack, and turn the
+   node with the most depth left (among the nodes above the busy
+   thread's latest split point) into a split point, rather than waiting
+   for some thread to decide to split where it happens to be. To get
+   the position at that node, the idle thread replays the moves from
+   the root. */
+
+/* states of a node on the stack */
+#define DTS_FREE		0
+#define DTS_ENTER		1  /* the node hasn't been looked at yet */
+#define DTS_NEXT		2  /* the node is searching its moves */
+#define DTS_WAIT		3  /* the node is waiting for its helpers */
+
+/* what dts_enter() and dts_next() tell dts_run() to do next */
+#define DTS_MORE		0  /* keep going */
+#define DTS_DONE		1  /* the node is done, and v is its score */
+#define DTS_ABORT		2  /* the node's result isn't needed */
+
+#define DTS_SPLITS		(MAX_THREADS * 8)
+
+dts_thread dts_threads[MAX_THREADS];
+split_t dts_splits[DTS_SPLITS];
+volatile int dts_used[DTS_SPLITS];
+split_t dts_root;  /* the position at the root, for replaying moves */
+flag_t dts_done;
+
+
+/* dts_search() does search in parallel by Dynamic Tree Splitting.
+   Thread 0 searches from the root; the others look for work in
+   dts_idle(). */
+
+int dts_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int x = alpha;
+
+	split_save(p, &dts_root);
+	dts_done.val = FALSE;
+	#pragma omp parallel shared(x)
+	{
+		int i;
+		dts_thread *th = &dts_threads[omp_get_thread_num()];
+
+		th->lock = 0;
+		th->pause = 0;
+		th->busy = FALSE;
+		th->top = -1;
+		th->pos = omp_get_thread_num() ? &pos_dat[omp_get_thread_num()] : p;
+		for (i = 0; i < MAX_PLY; ++i)
+			th->frame[i].state = DTS_FREE;
+		#pragma omp barrier
+		if (omp_get_thread_num() == 0) {
+			x = dts_run(th, alpha, beta, depth, NULL);
+			dts_done.val = TRUE;
+		}
+		else
+			dts_idle(th, NULL);
+	}
+	return x;
+}
+
+
+/* dts_run() searches the current position, returning its score. It's
+   the same search as search(), except the nodes are kept on th's
+   stack instead of the C stack. under is the split point the node is
+   being searched under, if any. */
+
+int dts_run(dts_thread *th, int alpha, int beta, int depth, split_t *under)
+{
+	int base, r, v;
+	BOOL busy;
+	dts_frame *f;
+	pos_t *p = th->pos;
+
+	busy = th->busy;
+	th->busy = TRUE;
+	base = p->ply;
+	dts_push(th, alpha, beta, depth, under, TRUE);
+	for (;;) {
+		if (th->pause == 1)
+			dts_pause(th);
+		f = &th->frame[p->ply];
+		if (f->state == DTS_ENTER)
+			r = dts_enter(p, f, &v);
+		else
+			r = dts_next(th, f, &v);
+		if (r == DTS_MORE)
+			continue;
+
+		/* pop the node, and pass its score to its parent. that
+		   might cause a cutoff, in which case the parent is
+		   done too, and so on. */
+		for (;;) {
+			f->state = DTS_FREE;
+			if (p->ply == base) {
+				th->top = base - 1;
+				th->busy = busy;
+				return r == DTS_DONE ? v : alpha;
+			}
+			takeback(p);
+			th->top = p->ply;
+			f = &th->frame[p->ply];
+			if (r == DTS_ABORT)
+				break;
+			++f->searched;
+			if (!dts_result(p, f, -v))
+				break;
+			v = f->beta;
+		}
+	}
+}
+
+
+/* dts_push() puts a new node on th's stack for the current ply. */
+
+void dts_push(dts_thread *th, int alpha, int beta, int depth,
+		split_t *under, BOOL base)
+{
+	dts_frame *f = &th->frame[th->pos->ply];
+
+	f->alpha = alpha;
+	f->beta = beta;
+	f->depth = depth;
+	f->searched = 0;
+	f->legal = FALSE;
+	f->base = base;
+	f->best.u = 0;
+	f->sp = NULL;
+	f->under = under;
+	f->state = DTS_ENTER;
+	th->top = th->pos->ply;
+}
+
+
+/* dts_enter() does everything search() does before its move loop. */
+
+int dts_enter(pos_t *p, dts_frame *f, int *v)
+{
+	int x;
+	move hash_move;
+
+	/* we're as deep as we want to be; call quiesce() to get
+	   a reasonable score and return it. */
+	if (!f->depth) {
+		*v = (*quiesce_func)(p, f->alpha, f->beta);
+		return DTS_DONE;
+	}
+
+	++p->nodes;
+
+	/* has time run out? (see timer.c) */
+	if (stop_search.val) {
+		*v = f->alpha;
+		return DTS_DONE;
+	}
+
+	p->pv_length[p->ply] = p->ply;
+
+	/* is the position a repeat? */
+	if (p->ply && reps(p)) {
+		*v = 0;
+		return DTS_DONE;
+	}
+
+	/* are we too deep? */
+	if (p->ply >= MAX_PLY - 1 || p->hply >= HIST_STACK - 1) {
+		*v = (*eval_func)(p);
+		return DTS_DONE;
+	}
+
+	/* are we in check? if so, we want to search deeper */
+	f->check = in_check(p, p->side);
+	if (f->check)
+		++f->depth;
+
+	/* have we searched this position before? */
+	if (tt_probe(p, f->depth, f->alpha, f->beta, &x, &hash_move) && p->ply) {
+		*v = x;
+		return DTS_DONE;
+	}
+
+	gen(p);
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+	f->next = p->first_move[p->ply];
+	f->last = p->first_move[p->ply + 1];
+	f->state = DTS_NEXT;
+	return DTS_MORE;
+}
+
+
+/* dts_next() makes the node's next move and pushes the resulting
+   position on the stack. If the node has been made a split point,
+   the move comes from the split point instead. */
+
+int dts_next(dts_thread *th, dts_frame *f, int *v)
+{
+	int i, a;
+	split_t *sp = f->sp;
+	pos_t *p = th->pos;
+
+	if (stop_search.val || split_aborted(f->under)) {
+		dts_leave(th, f);
+		return DTS_ABORT;
+	}
+	if (sp) {
+		LOCK(sp->lock);
+		if (!sp->cutoff && sp->next < sp->last) {
+			i = sp->next++;
+		}
+		else
+			i = -1;
+		UNLOCK(sp->lock);
+		a = SPLIT_ALPHA(sp->bound);
+		if (i < 0)
+			return dts_finish(th, f, v);
+	}
+	else {
+		if (f->next >= f->last)
+			return dts_end(p, f, v);
+		i = f->next++;
+		sort(p, i);
+		a = f->alpha;
+	}
+	makemove(p, p->gen_dat[i].m.b);
+	f->legal = TRUE;
+	f->cur = p->gen_dat[i].m;
+	dts_push(th, -f->beta, -a, f->depth - 1, sp ? sp : f->under, FALSE);
+	return DTS_MORE;
+}
+
+
+/* dts_result() updates node f with the score x of the move it just
+   searched. It returns TRUE if the move caused a cutoff. */
+
+BOOL dts_result(pos_t *p, dts_frame *f, int x)
+{
+	int j;
+
+	if (stop_search.val || split_aborted(f->under))
+		return FALSE;
+	if (f->sp) {
+		split_merge(p, f->sp, f->cur, x);
+		return FALSE;
+	}
+	if (x > f->alpha) {
+		p->history[(int)f->cur.b.from][(int)f->cur.b.to] += f->depth;
+		if (x >= f->beta) {
+			tt_store(p, f->depth, f->beta, TT_LOWER, f->cur);
+			return TRUE;
+		}
+		f->alpha = x;
+		f->best = f->cur;
+
+		/* update the PV */
+		p->pv[p->ply][p->ply] = f->cur;
+		for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+			p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+		p->pv_length[p->ply] = p->pv_length[p->ply + 1];
+	}
+	return FALSE;
+}
+
+
+/* dts_end() does everything search() does after its move loop. */
+
+int dts_end(pos_t *p, dts_frame *f, int *v)
+{
+	/* no legal moves? then we're in checkmate or stalemate */
+	if (!f->legal)
+		*v = f->check ? -10000 + p->ply : 0;
+
+	/* fifty move draw rule */
+	else if (p->fifty >= 100)
+		*v = 0;
+	else {
+		tt_store(p, f->depth, f->alpha, f->best.u ? TT_EXACT : TT_UPPER, f->best);
+		*v = f->alpha;
+	}
+	return DTS_DONE;
+}
+
+
+/* dts_finish() is called when there are no moves left at split point
+   node f. It waits for the helpers to finish (helping them meanwhile),
+   then takes the split point's result. */
+
+int dts_finish(dts_thread *th, dts_frame *f, int *v)
+{
+	split_t *sp = f->sp;
+	pos_t *p = th->pos;
+
+	f->state = DTS_WAIT;
+	LOCK(sp->lock);
+	--sp->workers;
+	UNLOCK(sp->lock);
+	dts_idle(th, sp);
+
+	/* the board was overwritten if we helped elsewhere while waiting */
+	split_load(p, sp);
+	p->first_move[p->ply + 1] = f->last;
+	f->state = DTS_NEXT;
+	f->sp = NULL;
+	if (stop_search.val || split_aborted(f->under)) {
+		dts_free(sp);
+		return DTS_ABORT;
+	}
+	f->alpha = split_result(p, sp, &f->best);
+	if (sp->cutoff) {
+		dts_free(sp);
+		tt_store(p, f->depth, f->beta, TT_LOWER, f->best);
+		*v = f->beta;
+		return DTS_DONE;
+	}
+	dts_free(sp);
+	return dts_end(p, f, v);
+}
+
+
+/* dts_leave() is called when node f is being abandoned. If it's a
+   split point, its helpers have to get out before it can go. */
+
+void dts_leave(dts_thread *th, dts_frame *f)
+{
+	split_t *sp = f->sp;
+
+	if (!sp)
+		return;
+	LOCK(sp->lock);
+	sp->next = sp->last;  /* so nobody else joins */
+	--sp->workers;
+	UNLOCK(sp->lock);
+	while (sp->workers)
+		if (th->pause == 1)
+			dts_pause(th);
+	f->sp = NULL;
+	dts_free(sp);
+}
+
+
+/* dts_pause() lets an idle thread look at (and change) th's stack. */
+
+void dts_pause(dts_thread *th)
+{
+	__sync_synchronize();
+	th->pause = 2;
+	while (th->pause == 2)
+		;
+	__sync_synchronize();
+}
+
+
+/* dts_idle() is where a thread looks for work: first a split point
+   with moves left, then a busy thread's node to split. Helper threads
+   stay here (with wait == NULL) until the search is over. A split
+   point's owner stays here until its helpers are done (wait == its
+   split point), meanwhile only helping below its own split point. */
+
+void dts_idle(dts_thread *th, split_t *wait)
+{
+	int top, gen_base;
+	BOOL busy;
+	split_t *sp;
+
+	busy = th->busy;
+	top = th->top;
+	gen_base = wait ? th->frame[th->pos->ply].last : 0;
+	th->busy = FALSE;
+	for (;;) {
+		if (th->pause == 1)
+			dts_pause(th);
+		if (wait ? wait->workers == 0 : dts_done.val)
+			break;
+		sp = dts_join(wait);
+		if (!sp)
+			sp = dts_steal(th, wait);
+		if (sp) {
+			dts_work(th, sp, gen_base);
+			th->top = top;
+		}
+	}
+	th->busy = busy;
+}
+
+
+/* dts_work() searches moves at split point sp until there are none
+   left, then leaves the split point. Move lists go in gen_dat above
+   gen_base, so that the thread's own lists (if it's waiting at a
+   split point of its own) aren't overwritten. */
+
+void dts_work(dts_thread *th, split_t *sp, int gen_base)
+{
+	int i, x, a, n;
+	move m;
+	pos_t *p = th->pos;
+
+	split_load(p, sp);
+	p->first_move[p->ply + 1] = gen_base;
+	for (;;) {
+		LOCK(sp->lock);
+		if (sp->cutoff || sp->next >= sp->last || stop_search.val) {
+			UNLOCK(sp->lock);
+			break;
+		}
+		i = sp->next++;
+		UNLOCK(sp->lock);
+		a = SPLIT_ALPHA(sp->bound);
+
+		m = sp->moves[i].m;
+		makemove(p, m.b);
+		n = p->nodes;
+		x = -dts_run(th, -sp->beta, -a, sp->depth - 1, sp);
+		takeback(p);
+		if (stop_search.val || split_aborted(sp))
+			break;
+		split_learn(sp->depth, p->nodes - n);
+		split_merge(p, sp, m, x);
+	}
+
+	LOCK(sp->lock);
+	--sp->workers;
+	UNLOCK(sp->lock);
+}
+
+
+/* dts_join() joins the split point with the most depth left that
+   still has moves to search (below wait, if wait isn't NULL). It
+   returns NULL if there wasn't one. */
+
+split_t *dts_join(split_t *wait)
+{
+	int i;
+	split_t *sp, *bsp;
+
+	bsp = NULL;
+	for (i = 0; i < DTS_SPLITS; ++i) {
+		if (!dts_used[i])
+			continue;
+		sp = &dts_splits[i];
+		if (sp->active && !sp->cutoff && sp->next < sp->last &&
+				(!wait || split_under(sp->parent, wait)) &&
+				(!bsp || sp->depth > bsp->depth))
+			bsp = sp;
+	}
+	if (!bsp)
+		return NULL;
+
+	LOCK(bsp->lock);
+	if (!bsp->active || bsp->cutoff || bsp->next >= bsp->last ||
+			(wait && !split_under(bsp->parent, wait))) {
+		UNLOCK(bsp->lock);
+		return NULL;
+	}
+	++bsp->workers;
+	UNLOCK(bsp->lock);
+	return bsp;
+}
+
+
+/* dts_steal() pauses each busy thread in turn, looking for a node on
+   its stack to split. It returns the new split point, which th has
+   already joined, or NULL. */
+
+split_t *dts_steal(dts_thread *th, split_t *wait)
+{
+	int t, j;
+	dts_thread *v;
+	split_t *sp = NULL;
+
+	for (t = 0; t < threads && !sp; ++t) {
+		v = &dts_threads[t];
+		if (v == th || !v->busy)
+			continue;
+
+		/* take a look at v's stack without pausing it first. v
+		   might be changing it, but if there's nothing to split
+		   it's not worth stopping v to make sure */
+		if (dts_pick(v, wait) < 0)
+			continue;
+		if (__sync_lock_test_and_set(&v->lock, 1))
+			continue;  /* someone else is looking at it */
+		v->pause = 1;
+
+		/* if someone wants to look at our stack while we wait,
+		   or v stops searching, give up on v */
+		while (v->pause == 1)
+			if (th->pause == 1 || !v->busy) {
+				__sync_bool_compare_and_swap(&v->pause, 1, 0);
+				break;
+			}
+		if (v->pause == 2) {
+			__sync_synchronize();
+			j = dts_pick(v, wait);
+			if (j >= 0)
+				sp = dts_split(th, v, j);
+			__sync_synchronize();
+			v->pause = 0;
+		}
+		UNLOCK(v->lock);
+		if (th->pause == 1)
+			break;
+	}
+	return sp;
+}
+
+
+/* dts_pick() returns the ply of the best node on paused thread v's
+   stack to split, or -1 if there isn't one. A node can be split if
+   at least one of its moves has been searched, it has moves left, and
+   there's enough depth left. Only nodes above v's latest split point
+   (or the point where v joined someone else's) are considered, and of
+   those the one closest to the root is best. */
+
+int dts_pick(dts_thread *v, split_t *wait)
+{
+	int j, best;
+	dts_frame *f;
+
+	best = -1;
+	for (j = v->top; j >= 0; --j) {
+		f = &v->frame[j];
+		if (f->sp)
+			break;
+		if (f->state == DTS_NEXT && f->searched && f->next < f->last &&
+				split_ok(f->depth, f->last - f->next) &&
+				(!wait || split_under(f->under, wait)))
+			best = j;
+		if (f->base)
+			break;
+	}
+	return best;
+}
+
+
+/* dts_split() makes the node at ply j on paused thread v's stack a
+   split point, with v and th as its workers. */
+
+split_t *dts_split(dts_thread *th, dts_thread *v, int j)
+{
+	int i;
+	dts_frame *f = &v->frame[j];
+	split_t *sp;
+	pos_t *p = th->pos;
+	pos_t *vp = v->pos;
+
+	sp = dts_alloc();
+	if (!sp)
+		return NULL;
+
+	/* get the node's position by replaying v's moves from the root */
+	split_load(p, &dts_root);
+	for (i = 0; i < j; ++i)
+		makemove(p, vp->hist_dat[dts_root.hply + i].m.b);
+	split_save(p, sp);
+
+	/* all threads pick moves off the front of the list, so
+	   it has to be sorted up front */
+	dts_sort(vp->gen_dat, f->next, f->last);
+
+	sp->parent = f->under;
+	sp->cutoff = FALSE;
+	sp->beta = f->beta;
+	sp->depth = f->depth;
+	sp->next = f->next;
+	sp->last = f->last;
+	sp->workers = 2;
+	sp->moves = vp->gen_dat;
+	split_set(sp, vp, j, f->alpha, f->best);
+	LOCK(sp->lock);
+	sp->active = TRUE;
+	UNLOCK(sp->lock);
+
+	/* the nodes above this one are now searched under it */
+	f->sp = sp;
+	for (i = j + 1; i <= v->top; ++i)
+		v->frame[i].under = sp;
+	return sp;
+}
+
+
+/* dts_alloc() gets an unused split point, or NULL if there are none. */
+
+split_t *dts_alloc()
+{
+	int i;
+
+	for (i = 0; i < DTS_SPLITS; ++i)
+		if (!dts_used[i] && !__sync_lock_test_and_set(&dts_used[i], 1))
+			return &dts_splits[i];
+	return NULL;
+}
+
+
+/* dts_free() gives back a split point that nobody's working at. */
+
+void dts_free(split_t *sp)
+{
+	LOCK(sp->lock);
+	sp->active = FALSE;
+	UNLOCK(sp->lock);
+	__sync_lock_release(&dts_used[sp - dts_splits]);
+}
+
+
+/* dts_sort() sorts moves from to last of move list g by score, like
+   sort() does one move at a time. */
+
+void dts_sort(gen_t *g, int from, int last)
+{
+	int i, j, bi;
+	gen_t t;
+
+	for (i = from; i < last; ++i) {
+		bi = i;
+		for (j = i + 1; j < last; ++j)
+			if (g[j].score > g[bi].score)
+				bi = j;
+		t = g[i];
+		g[i] = g[bi];
+		g[bi] = t;
+	}
+}
@@ -102,142 +102,113 @@ int flip[64] = {
 	  0,   1,   2,   3,   4,   5,   6,   7
 };
 
-/* pawn_rank[x][y] is the rank of the least advanced pawn of color x on file
-   y - 1. There are "buffer files" on the left and right to avoid special-case
-   logic later. If there's no pawn on a rank, we pretend the pawn is
-   impossibly far advanced (0 for LIGHT and 7 for DARK). This makes it easy to
-   test for pawns on a rank and it simplifies some pawn evaluation code. */
-int (*pawn_rank)[10];
-
-int *piece_mat;  /* the value of a side's pieces */
-int *pawn_mat;  /* the value of a side's pawns */
-
-#pragma omp threadprivate(color, piece, side)
-#pragma omp threadprivate(pawn_rank, piece_mat, pawn_mat)
-
-// private versions for parallel search
-int priv_pawn_rank[2][10];
-int priv_piece_mat[2]; 
-int priv_pawn_mat[2];
-
-#pragma omp threadprivate(priv_pawn_rank, priv_piece_mat, priv_pawn_mat)
-
-// shared versions for parallel evaluation
-int shared_pawn_rank[2][10];
-int shared_piece_mat[2];
-int shared_pawn_mat[2];
-
-
 /* eval() returns the current position's static score, from the perspective
    of the player to move. */
 
-int eval()
+int eval(pos_t *p)
 {
-	int i;
+	int i, c, k;
 	int f;  /* file */
 	int score[2];  /* each side's score */
-	
-	pawn_rank = priv_pawn_rank;
-	piece_mat = priv_piece_mat;
-	pawn_mat = priv_pawn_mat;
+	eval_t e;
 	
 	/* this is the first pass: set up pawn_rank, piece_mat, and pawn_mat. */
 	for (i = 0; i < 10; ++i) {
-		pawn_rank[LIGHT][i] = 0;
-		pawn_rank[DARK][i] = 7;
+		e.pawn_rank[LIGHT][i] = 0;
+		e.pawn_rank[DARK][i] = 7;
 	}
-	piece_mat[LIGHT] = 0;
-	piece_mat[DARK] = 0;
-	pawn_mat[LIGHT] = 0;
-	pawn_mat[DARK] = 0;
-	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
-			continue;
-		if (piece[i] == PAWN) {
-			pawn_mat[color[i]] += piece_value[PAWN];
-			f = COL(i) + 1;  /* add 1 because of the extra file in the array */
-			if (color[i] == LIGHT) {
-				if (pawn_rank[LIGHT][f] < ROW(i))
-					pawn_rank[LIGHT][f] = ROW(i);
-			}
-			else {
-				if (pawn_rank[DARK][f] > ROW(i))
-					pawn_rank[DARK][f] = ROW(i);
+	e.piece_mat[LIGHT] = 0;
+	e.piece_mat[DARK] = 0;
+	e.pawn_mat[LIGHT] = 0;
+	e.pawn_mat[DARK] = 0;
+	for (c = LIGHT; c <= DARK; ++c)
+		for (k = 0; k < p->piece_count[c]; ++k) {
+			i = p->piece_list[c][k];
+			if (p->piece[i] == PAWN) {
+				e.pawn_mat[p->color[i]] += piece_value[PAWN];
+				f = COL(i) + 1;  /* add 1 because of the extra file in the array */
+				if (p->color[i] == LIGHT) {
+					if (e.pawn_rank[LIGHT][f] < ROW(i))
+						e.pawn_rank[LIGHT][f] = ROW(i);
+				}
+				else {
+					if (e.pawn_rank[DARK][f] > ROW(i))
+						e.pawn_rank[DARK][f] = ROW(i);
+				}
 			}
+			else
+				e.piece_mat[p->color[i]] += piece_value[p->piece[i]];
 		}
-		else
-			piece_mat[color[i]] += piece_value[piece[i]];
-	}
 
 	/* this is the second pass: evaluate each piece */
-	score[LIGHT] = piece_mat[LIGHT] + pawn_mat[LIGHT];
-	score[DARK] = piece_mat[DARK] + pawn_mat[DARK];
-	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
-			continue;
-		if (color[i] == LIGHT) {
-			switch (piece[i]) {
-				case PAWN:
-					score[LIGHT] += eval_light_pawn(i);
-					break;
-				case KNIGHT:
-					score[LIGHT] += knight_pcsq[i];
-					break;
-				case BISHOP:
-					score[LIGHT] += bishop_pcsq[i];
-					break;
-				case ROOK:
-					if (pawn_rank[LIGHT][COL(i) + 1] == 0) {
-						if (pawn_rank[DARK][COL(i) + 1] == 7)
-							score[LIGHT] += ROOK_OPEN_FILE_BONUS;
+	score[LIGHT] = e.piece_mat[LIGHT] + e.pawn_mat[LIGHT];
+	score[DARK] = e.piece_mat[DARK] + e.pawn_mat[DARK];
+	for (c = LIGHT; c <= DARK; ++c)
+		for (k = 0; k < p->piece_count[c]; ++k) {
+			i = p->piece_list[c][k];
+			if (p->color[i] == LIGHT) {
+				switch (p->piece[i]) {
+					case PAWN:
+						score[LIGHT] += eval_light_pawn(&e, i);
+						break;
+					case KNIGHT:
+						score[LIGHT] += knight_pcsq[i];
+						break;
+					case BISHOP:
+						score[LIGHT] += bishop_pcsq[i];
+						break;
+					case ROOK:
+						if (e.pawn_rank[LIGHT][COL(i) + 1] == 0) {
+							if (e.pawn_rank[DARK][COL(i) + 1] == 7)
+								score[LIGHT] += ROOK_OPEN_FILE_BONUS;
+							else
+								score[LIGHT] += ROOK_SEMI_OPEN_FILE_BONUS;
+						}
+						if (ROW(i) == 1)
+							score[LIGHT] += ROOK_ON_SEVENTH_BONUS;
+						break;
+					case KING:
+						if (e.piece_mat[DARK] <= 1200)
+							score[LIGHT] += king_endgame_pcsq[i];
 						else
-							score[LIGHT] += ROOK_SEMI_OPEN_FILE_BONUS;
-					}
-					if (ROW(i) == 1)
-						score[LIGHT] += ROOK_ON_SEVENTH_BONUS;
-					break;
-				case KING:
-					if (piece_mat[DARK] <= 1200)
-						score[LIGHT] += king_endgame_pcsq[i];
-					else
-						score[LIGHT] += eval_light_king(i);
-					break;
+							score[LIGHT] += eval_light_king(&e, i);
+						break;
+				}
 			}
-		}
-		else {
-			switch (piece[i]) {
-				case PAWN:
-					score[DARK] += eval_dark_pawn(i);
-					break;
-				case KNIGHT:
-					score[DARK] += knight_pcsq[flip[i]];
-					break;
-				case BISHOP:
-					score[DARK] += bishop_pcsq[flip[i]];
-					break;
-				case ROOK:
-					if (pawn_rank[DARK][COL(i) + 1] == 7) {
-						if (pawn_rank[LIGHT][COL(i) + 1] == 0)
-							score[DARK] += ROOK_OPEN_FILE_BONUS;
+			else {
+				switch (p->piece[i]) {
+					case PAWN:
+						score[DARK] += eval_dark_pawn(&e, i);
+						break;
+					case KNIGHT:
+						score[DARK] += knight_pcsq[flip[i]];
+						break;
+					case BISHOP:
+						score[DARK] += bishop_pcsq[flip[i]];
+						break;
+					case ROOK:
+						if (e.pawn_rank[DARK][COL(i) + 1] == 7) {
+							if (e.pawn_rank[LIGHT][COL(i) + 1] == 0)
+								score[DARK] += ROOK_OPEN_FILE_BONUS;
+							else
+								score[DARK] += ROOK_SEMI_OPEN_FILE_BONUS;
+						}
+						if (ROW(i) == 6)
+							score[DARK] += ROOK_ON_SEVENTH_BONUS;
+						break;
+					case KING:
+						if (e.piece_mat[LIGHT] <= 1200)
+							score[DARK] += king_endgame_pcsq[flip[i]];
 						else
-							score[DARK] += ROOK_SEMI_OPEN_FILE_BONUS;
-					}
-					if (ROW(i) == 6)
-						score[DARK] += ROOK_ON_SEVENTH_BONUS;
-					break;
-				case KING:
-					if (piece_mat[LIGHT] <= 1200)
-						score[DARK] += king_endgame_pcsq[flip[i]];
-					else
-						score[DARK] += eval_dark_king(i);
-					break;
+							score[DARK] += eval_dark_king(&e, i);
+						break;
+				}
 			}
 		}
-	}
 
 	/* the score[] array is set, now return the score relative
 	   to the side to move */
-	if (side == LIGHT)
+	if (p->side == LIGHT)
 		return score[LIGHT] - score[DARK];
 	return score[DARK] - score[LIGHT];
 }
@@ -246,62 +217,59 @@ int eval()
 /* p_eval() is a parallelized copy of eval(). Doesn't yield speedups, but I
    keep it as a demonstration. */
    
-int p_eval()
+int p_eval(pos_t *p)
 {
 	int i;
 	int f;  /* file */
 	int score[2];  /* each side's score */
+	eval_t e;
 	
-	#pragma omp parallel copyin(color, piece, side)
+	#pragma omp parallel
 	{
-	pawn_rank = shared_pawn_rank;
-	piece_mat = shared_piece_mat;
-	pawn_mat = shared_pawn_mat;
-	
 	#pragma omp single
 	{
 	/* this is the first pass: set up pawn_rank, piece_mat, and pawn_mat 
 	   (tried parallelizing, but makes function even slower) */
 	for (i = 0; i < 10; ++i) {
-		pawn_rank[LIGHT][i] = 0;
-		pawn_rank[DARK][i] = 7;
+		e.pawn_rank[LIGHT][i] = 0;
+		e.pawn_rank[DARK][i] = 7;
 	}
-	piece_mat[LIGHT] = 0;
-	piece_mat[DARK] = 0;
-	pawn_mat[LIGHT] = 0;
-	pawn_mat[DARK] = 0;
+	e.piece_mat[LIGHT] = 0;
+	e.piece_mat[DARK] = 0;
+	e.pawn_mat[LIGHT] = 0;
+	e.pawn_mat[DARK] = 0;
 	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
+		if (p->color[i] == EMPTY)
 			continue;
-		if (piece[i] == PAWN) {
-			pawn_mat[color[i]] += piece_value[PAWN];
+		if (p->piece[i] == PAWN) {
+			e.pawn_mat[p->color[i]] += piece_value[PAWN];
 			f = COL(i) + 1;  /* add 1 because of the extra file in the array */
-			if (color[i] == LIGHT) {
-				if (pawn_rank[LIGHT][f] < ROW(i))
-					pawn_rank[LIGHT][f] = ROW(i);
+			if (p->color[i] == LIGHT) {
+				if (e.pawn_rank[LIGHT][f] < ROW(i))
+					e.pawn_rank[LIGHT][f] = ROW(i);
 			}
 			else {
-				if (pawn_rank[DARK][f] > ROW(i))
-					pawn_rank[DARK][f] = ROW(i);
+				if (e.pawn_rank[DARK][f] > ROW(i))
+					e.pawn_rank[DARK][f] = ROW(i);
 			}
 		}
 		else
-			piece_mat[color[i]] += piece_value[piece[i]];
+			e.piece_mat[p->color[i]] += piece_value[p->piece[i]];
 	}
-	score[LIGHT] = piece_mat[LIGHT] + pawn_mat[LIGHT];
-	score[DARK] = piece_mat[DARK] + pawn_mat[DARK];
+	score[LIGHT] = e.piece_mat[LIGHT] + e.pawn_mat[LIGHT];
+	score[DARK] = e.piece_mat[DARK] + e.pawn_mat[DARK];
 	}
 
 	/* this is the second pass: evaluate each piece (in parallel) */	
 	int own_score[2] = {0, 0};
 	#pragma omp for private(i) nowait
 	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
+		if (p->color[i] == EMPTY)
 			continue;
-		if (color[i] == LIGHT) {
-			switch (piece[i]) {
+		if (p->color[i] == LIGHT) {
+			switch (p->piece[i]) {
 				case PAWN:
-					own_score[LIGHT] += eval_light_pawn(i);
+					own_score[LIGHT] += eval_light_pawn(&e, i);
 					break;
 				case KNIGHT:
 					own_score[LIGHT] += knight_pcsq[i];
@@ -310,8 +278,8 @@ int p_eval()
 					own_score[LIGHT] += bishop_pcsq[i];
 					break;
 				case ROOK:
-					if (pawn_rank[LIGHT][COL(i) + 1] == 0) {
-						if (pawn_rank[DARK][COL(i) + 1] == 7)
+					if (e.pawn_rank[LIGHT][COL(i) + 1] == 0) {
+						if (e.pawn_rank[DARK][COL(i) + 1] == 7)
 							own_score[LIGHT] += ROOK_OPEN_FILE_BONUS;
 						else
 							own_score[LIGHT] += ROOK_SEMI_OPEN_FILE_BONUS;
@@ -320,17 +288,17 @@ int p_eval()
 						own_score[LIGHT] += ROOK_ON_SEVENTH_BONUS;
 					break;
 				case KING:
-					if (piece_mat[DARK] <= 1200)
+					if (e.piece_mat[DARK] <= 1200)
 						own_score[LIGHT] += king_endgame_pcsq[i];
 					else
-						own_score[LIGHT] += eval_light_king(i);
+						own_score[LIGHT] += eval_light_king(&e, i);
 					break;
 			}
 		}
 		else {
-			switch (piece[i]) {
+			switch (p->piece[i]) {
 				case PAWN:
-					own_score[DARK] += eval_dark_pawn(i);
+					own_score[DARK] += eval_dark_pawn(&e, i);
 					break;
 				case KNIGHT:
 					own_score[DARK] += knight_pcsq[flip[i]];
@@ -339,8 +307,8 @@ int p_eval()
 					own_score[DARK] += bishop_pcsq[flip[i]];
 					break;
 				case ROOK:
-					if (pawn_rank[DARK][COL(i) + 1] == 7) {
-						if (pawn_rank[LIGHT][COL(i) + 1] == 0)
+					if (e.pawn_rank[DARK][COL(i) + 1] == 7) {
+						if (e.pawn_rank[LIGHT][COL(i) + 1] == 0)
 							own_score[DARK] += ROOK_OPEN_FILE_BONUS;
 						else
 							own_score[DARK] += ROOK_SEMI_OPEN_FILE_BONUS;
@@ -349,10 +317,10 @@ int p_eval()
 						own_score[DARK] += ROOK_ON_SEVENTH_BONUS;
 					break;
 				case KING:
-					if (piece_mat[LIGHT] <= 1200)
+					if (e.piece_mat[LIGHT] <= 1200)
 						own_score[DARK] += king_endgame_pcsq[flip[i]];
 					else
-						own_score[DARK] += eval_dark_king(i);
+						own_score[DARK] += eval_dark_king(&e, i);
 					break;
 			}
 		}
@@ -365,14 +333,14 @@ int p_eval()
 
 	/* the score[] array is set, now return the score relative
 	   to the side to move */
-	if (side == LIGHT)
+	if (p->side == LIGHT)
 		return score[LIGHT] - score[DARK];
 
 	return score[DARK] - score[LIGHT];	
 }
 
 
-int eval_light_pawn(int sq)
+int eval_light_pawn(eval_t *e, int sq)
 {
 	int r;  /* the value to return */
 	int f;  /* the pawn's file */
@@ -383,30 +351,30 @@ int eval_light_pawn(int sq)
 	r += pawn_pcsq[sq];
 
 	/* if there's a pawn behind this one, it's doubled */
-	if (pawn_rank[LIGHT][f] > ROW(sq))
+	if (e->pawn_rank[LIGHT][f] > ROW(sq))
 		r -= DOUBLED_PAWN_PENALTY;
 
 	/* if there aren't any friendly pawns on either side of
 	   this one, it's isolated */
-	if ((pawn_rank[LIGHT][f - 1] == 0) &&
-			(pawn_rank[LIGHT][f + 1] == 0))
+	if ((e->pawn_rank[LIGHT][f - 1] == 0) &&
+			(e->pawn_rank[LIGHT][f + 1] == 0))
 		r -= ISOLATED_PAWN_PENALTY;
 
 	/* if it's not isolated, it might be backwards */
-	else if ((pawn_rank[LIGHT][f - 1] < ROW(sq)) &&
-			(pawn_rank[LIGHT][f + 1] < ROW(sq)))
+	else if ((e->pawn_rank[LIGHT][f - 1] < ROW(sq)) &&
+			(e->pawn_rank[LIGHT][f + 1] < ROW(sq)))
 		r -= BACKWARDS_PAWN_PENALTY;
 
 	/* add a bonus if the pawn is passed */
-	if ((pawn_rank[DARK][f - 1] >= ROW(sq)) &&
-			(pawn_rank[DARK][f] >= ROW(sq)) &&
-			(pawn_rank[DARK][f + 1] >= ROW(sq)))
+	if ((e->pawn_rank[DARK][f - 1] >= ROW(sq)) &&
+			(e->pawn_rank[DARK][f] >= ROW(sq)) &&
+			(e->pawn_rank[DARK][f + 1] >= ROW(sq)))
 		r += (7 - ROW(sq)) * PASSED_PAWN_BONUS;
 
 	return r;
 }
 
-int eval_dark_pawn(int sq)
+int eval_dark_pawn(eval_t *e, int sq)
 {
 	int r;  /* the value to return */
 	int f;  /* the pawn's file */
@@ -417,30 +385,30 @@ int eval_dark_pawn(int sq)
 	r += pawn_pcsq[flip[sq]];
 
 	/* if there's a pawn behind this one, it's doubled */
-	if (pawn_rank[DARK][f] < ROW(sq))
+	if (e->pawn_rank[DARK][f] < ROW(sq))
 		r -= DOUBLED_PAWN_PENALTY;
 
 	/* if there aren't any friendly pawns on either side of
 	   this one, it's isolated */
-	if ((pawn_rank[DARK][f - 1] == 7) &&
-			(pawn_rank[DARK][f + 1] == 7))
+	if ((e->pawn_rank[DARK][f - 1] == 7) &&
+			(e->pawn_rank[DARK][f + 1] == 7))
 		r -= ISOLATED_PAWN_PENALTY;
 
 	/* if it's not isolated, it might be backwards */
-	else if ((pawn_rank[DARK][f - 1] > ROW(sq)) &&
-			(pawn_rank[DARK][f + 1] > ROW(sq)))
+	else if ((e->pawn_rank[DARK][f - 1] > ROW(sq)) &&
+			(e->pawn_rank[DARK][f + 1] > ROW(sq)))
 		r -= BACKWARDS_PAWN_PENALTY;
 
 	/* add a bonus if the pawn is passed */
-	if ((pawn_rank[LIGHT][f - 1] <= ROW(sq)) &&
-			(pawn_rank[LIGHT][f] <= ROW(sq)) &&
-			(pawn_rank[LIGHT][f + 1] <= ROW(sq)))
+	if ((e->pawn_rank[LIGHT][f - 1] <= ROW(sq)) &&
+			(e->pawn_rank[LIGHT][f] <= ROW(sq)) &&
+			(e->pawn_rank[LIGHT][f + 1] <= ROW(sq)))
 		r += ROW(sq) * PASSED_PAWN_BONUS;
 
 	return r;
 }
 
-int eval_light_king(int sq)
+int eval_light_king(eval_t *e, int sq)
 {
 	int r;  /* the value to return */
 	int i;
@@ -450,103 +418,103 @@ int eval_light_king(int sq)
 	/* if the king is castled, use a special function to evaluate the
 	   pawns on the appropriate side */
 	if (COL(sq) < 3) {
-		r += eval_lkp(1);
-		r += eval_lkp(2);
-		r += eval_lkp(3) / 2;  /* problems with pawns on the c & f files
+		r += eval_lkp(e, 1);
+		r += eval_lkp(e, 2);
+		r += eval_lkp(e, 3) / 2;  /* problems with pawns on the c & f files
 								  are not as severe */
 	}
 	else if (COL(sq) > 4) {
-		r += eval_lkp(8);
-		r += eval_lkp(7);
-		r += eval_lkp(6) / 2;
+		r += eval_lkp(e, 8);
+		r += eval_lkp(e, 7);
+		r += eval_lkp(e, 6) / 2;
 	}
 
 	/* otherwise, just assess a penalty if there are open files near
 	   the king */
 	else {
 		for (i = COL(sq); i <= COL(sq) + 2; ++i)
-			if ((pawn_rank[LIGHT][i] == 0) &&
-					(pawn_rank[DARK][i] == 7))
+			if ((e->pawn_rank[LIGHT][i] == 0) &&
+					(e->pawn_rank[DARK][i] == 7))
 				r -= 10;
 	}
 
 	/* scale the king safety value according to the opponent's material;
 	   the premise is that your king safety can only be bad if the
 	   opponent has enough pieces to attack you */
-	r *= piece_mat[DARK];
+	r *= e->piece_mat[DARK];
 	r /= 3100;
 
 	return r;
 }
 
-/* eval_lkp(f) evaluates the Light King Pawn on file f */
+/* eval_lkp(e, f) evaluates the Light King Pawn on file f */
 
-int eval_lkp(int f)
+int eval_lkp(eval_t *e, int f)
 {
 	int r = 0;
 
-	if (pawn_rank[LIGHT][f] == 6);  /* pawn hasn't moved */
-	else if (pawn_rank[LIGHT][f] == 5)
+	if (e->pawn_rank[LIGHT][f] == 6);  /* pawn hasn't moved */
+	else if (e->pawn_rank[LIGHT][f] == 5)
 		r -= 10;  /* pawn moved one square */
-	else if (pawn_rank[LIGHT][f] != 0)
+	else if (e->pawn_rank[LIGHT][f] != 0)
 		r -= 20;  /* pawn moved more than one square */
 	else
 		r -= 25;  /* no pawn on this file */
 
-	if (pawn_rank[DARK][f] == 7)
+	if (e->pawn_rank[DARK][f] == 7)
 		r -= 15;  /* no enemy pawn */
-	else if (pawn_rank[DARK][f] == 5)
+	else if (e->pawn_rank[DARK][f] == 5)
 		r -= 10;  /* enemy pawn on the 3rd rank */
-	else if (pawn_rank[DARK][f] == 4)
+	else if (e->pawn_rank[DARK][f] == 4)
 		r -= 5;   /* enemy pawn on the 4th rank */
 
 	return r;
 }
 
-int eval_dark_king(int sq)
+int eval_dark_king(eval_t *e, int sq)
 {
 	int r;
 	int i;
 
 	r = king_pcsq[flip[sq]];
 	if (COL(sq) < 3) {
-		r += eval_dkp(1);
-		r += eval_dkp(2);
-		r += eval_dkp(3) / 2;
+		r += eval_dkp(e, 1);
+		r += eval_dkp(e, 2);
+		r += eval_dkp(e, 3) / 2;
 	}
 	else if (COL(sq) > 4) {
-		r += eval_dkp(8);
-		r += eval_dkp(7);
-		r += eval_dkp(6) / 2;
+		r += eval_dkp(e, 8);
+		r += eval_dkp(e, 7);
+		r += eval_dkp(e, 6) / 2;
 	}
 	else {
 		for (i = COL(sq); i <= COL(sq) + 2; ++i)
-			if ((pawn_rank[LIGHT][i] == 0) &&
-					(pawn_rank[DARK][i] == 7))
+			if ((e->pawn_rank[LIGHT][i] == 0) &&
+					(e->pawn_rank[DARK][i] == 7))
 				r -= 10;
 	}
-	r *= piece_mat[LIGHT];
+	r *= e->piece_mat[LIGHT];
 	r /= 3100;
 	return r;
 }
 
-int eval_dkp(int f)
+int eval_dkp(eval_t *e, int f)
 {
 	int r = 0;
 
-	if (pawn_rank[DARK][f] == 1);
-	else if (pawn_rank[DARK][f] == 2)
+	if (e->pawn_rank[DARK][f] == 1);
+	else if (e->pawn_rank[DARK][f] == 2)
 		r -= 10;
-	else if (pawn_rank[DARK][f] != 7)
+	else if (e->pawn_rank[DARK][f] != 7)
 		r -= 20;
 	else
 		r -= 25;
 
-	if (pawn_rank[LIGHT][f] == 0)
+	if (e->pawn_rank[LIGHT][f] == 0)
 		r -= 15;
-	else if (pawn_rank[LIGHT][f] == 2)
+	else if (e->pawn_rank[LIGHT][f] == 2)
 		r -= 10;
-	else if (pawn_rank[LIGHT][f] == 3)
+	else if (e->pawn_rank[LIGHT][f] == 3)
 		r -= 5;
 
 	return r;
@@ -9,6 +9,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <signal.h>
 #include <ctype.h>
@@ -43,6 +44,8 @@ int main()
 	int autoplay;
 	int last;
 	int m;
+	char *arg;
+	pos_t *p = &pos_dat[0];
 
 	printf("\n");
 	printf("Tom Kerrigan's Simple Chess Program (TSCP)\n");
@@ -53,9 +56,12 @@ int main()
 	printf("\"help\" displays a list of commands.\n");
 	printf("\n");
 	init_hash();
-	init_board();
+#ifdef BITBOARD
+	bb_init();
+#endif
+	init_board(p);
 	open_book();
-	gen();
+	gen(p);
 	computer_side = EMPTY;
 	autoplay = FALSE;
 	max_time = 1 << 25;
@@ -64,28 +70,47 @@ int main()
 	eval_func = &eval;
 	quiesce_func = &quiesce;
 	search_func = &search;
+	iterate_func = &iterate;
 	
 	omp_set_dynamic(FALSE);
 	threads = omp_get_max_threads();
+	if (threads > MAX_THREADS) {
+		threads = MAX_THREADS;
+		omp_set_num_threads(threads);
+	}
+
+	/* the helpers touch their positions first, so they're placed
+	   on the helpers' NUMA nodes */
+	numa_init();
+	numa_team();
+	for (m = 0; m < MAX_THREADS; ++m)
+		pos_dat[m].id = m;
+	pool_init(threads);
+	tt_init(16);
+	timer_init();
 	
 	for (;;) {
-		if (autoplay || side == computer_side) {  /* computer's turn */
+		if (autoplay || p->side == computer_side) {  /* computer's turn */
 			
 			/* think about the move and make it */
-			think(1);
-			if (!pv[0][0].u) {
+			think(p, 1);
+			if (!p->pv[0][0].u) {
 				printf("(no legal moves)\n");
 				computer_side = EMPTY;
 				autoplay = FALSE;
 				continue;
 			}
 			printf("Time: %d ms\n", get_ms() - start_time);
-			printf("Nodes: %d\n", nodes);
-			printf("Computer's move: %s\n", move_str(pv[0][0].b));
-			makemove(pv[0][0].b);
-			ply = 0;
-			gen();
-			print_result();
+			if (stop_latency >= 0)
+				printf("Stop latency: %d us\n", stop_latency);
+			printf("Nodes: %d\n", node_count());
+			printf("Hash full: %d/1000\n", tt_hashfull());
+			print_tt_hits();
+			printf("Computer's move: %s\n", move_str(p->pv[0][0].b));
+			makemove(p, p->pv[0][0].b);
+			p->ply = 0;
+			gen(p);
+			print_result(p);
 			continue;
 		}
 
@@ -94,7 +119,7 @@ int main()
 		if (scanf("%s", s) == EOF)
 			return 0;
 		if (!strcmp(s, "on")) {
-			computer_side = side;
+			computer_side = p->side;
 			continue;
 		}
 		if (!strcmp(s, "off")) {
@@ -117,22 +142,23 @@ int main()
 			continue;
 		}
 		if (!strcmp(s, "undo")) {
-			if (!hply)
+			if (!p->hply)
 				continue;
 			computer_side = EMPTY;
-			takeback();
-			ply = 0;
-			gen();
+			takeback(p);
+			p->ply = 0;
+			gen(p);
 			continue;
 		}
 		if (!strcmp(s, "new")) {
 			computer_side = EMPTY;
-			init_board();
-			gen();
+			init_board(p);
+			tt_clear();
+			gen(p);
 			continue;
 		}
 		if (!strcmp(s, "d")) {
-			print_board();
+			print_board(p);
 			continue;
 		}
 		if (!strcmp(s, "bench")) {
@@ -141,13 +167,21 @@ int main()
 			if (last >= 0 && s[last] == '\n')
 				s[last] = '\0';
 			computer_side = EMPTY;
-			bench(s, 1);
+			for (arg = s; *arg == ' '; ++arg)
+				;
+			if (!strncmp(arg, "all", 3))
+				bench_all(arg + 3);
+			else if (!strncmp(arg, "tune", 4))
+				bench_tune(arg + 4);
+			else
+				bench(s, 1);
 			continue;
 		}
 		if (!strcmp(s, "p")) {
 			eval_func = &eval;
 			quiesce_func = &quiesce;
 			search_func = &search;
+			iterate_func = &iterate;
 			while ((s[0] = getchar()) == ' ')
 				;
 			if (s[0] == 'e') {
@@ -162,6 +196,27 @@ int main()
 			} else if (s[0] == 'v') {
 				search_func = &pvs_search;
 				printf("Using parallel PV-splitting alpha-beta search.\n");
+			} else if (s[0] == 'y') {
+				search_func = &ybw_search;
+				printf("Using parallel YBWC alpha-beta search.\n");
+			} else if (s[0] == 'a') {
+				search_func = &abdada_search;
+				printf("Using parallel ABDADA alpha-beta search.\n");
+			} else if (s[0] == 'd') {
+				search_func = &dts_search;
+				printf("Using parallel DTS alpha-beta search.\n");
+			} else if (s[0] == 'w') {
+				search_func = &aspire_search;
+				printf("Using parallel aspiration window search.\n");
+			} else if (s[0] == 'm') {
+				search_func = &mp_search;
+				printf("Using multi-process root-splitting search.\n");
+			} else if (s[0] == 'n') {
+				search_func = &net_search;
+				printf("Using distributed PV-splitting search.\n");
+			} else if (s[0] == 'l') {
+				iterate_func = &lazy_iterate;
+				printf("Using Lazy SMP search.\n");
 			} else {
 				printf("Reset to serial functions.\n");
 			}
@@ -169,11 +224,130 @@ int main()
 		}
 		if (!strcmp(s, "t")) {
 			scanf("%d", &threads);
+			if (threads < 1)
+				threads = 1;
+			if (threads > MAX_THREADS)
+				threads = MAX_THREADS;
 			omp_set_num_threads(threads);
+			numa_team();
+			pool_init(threads);
 			printf("Set to use %d threads.\n", threads);
 			continue;
 		}
+		if (!strcmp(s, "split")) {
+			fgets(s, 256, stdin);
+			sscanf(s, "%d %d %d", &split_depth, &split_moves, &split_nodes);
+			printf("Splitting with at least %d ply, %d moves and %d nodes left.\n",
+					split_depth, split_moves, split_nodes);
+			printf("A split copies %d bytes, plus %d per ply from the root.\n",
+					(int)(offsetof(split_t, hist) - offsetof(split_t, color)),
+					(int)sizeof(hist_t));
+			printf("Each thread's position is %d KB (%d KB of it hash table).\n",
+					(int)(sizeof(pos_t) >> 10),
+					(int)(sizeof(pos_dat[0].tt_local) >> 10));
+			continue;
+		}
+		if (!strcmp(s, "procs")) {
+			scanf("%d", &m);
+			mp_init(m);
+			printf("Set to use %d worker processes.\n", procs);
+			continue;
+		}
+		if (!strcmp(s, "serve")) {
+			scanf("%d", &m);
+			net_serve(m);
+			continue;
+		}
+		if (!strcmp(s, "connect")) {
+			char port[16];
+			scanf("%255s %15s", s, port);
+			if (net_connect(s, port))
+				printf("Connected to %s port %s.\n", s, port);
+			else
+				printf("Can't connect to %s port %s.\n", s, port);
+			continue;
+		}
+		if (!strcmp(s, "disconnect")) {
+			net_disconnect();
+			printf("Disconnected from all workers.\n");
+			continue;
+		}
+		if (!strcmp(s, "bbcheck")) {
+			fgets(s, 256, stdin);
+			m = 0;
+			last = 0;
+			sscanf(s, "%d %n", &m, &last);
+#ifdef BITBOARD
+			{
+				int nodes = 0, errors;
+
+				/* like bench, a fen replaces the game */
+				if (s[last]) {
+					close_book();
+					computer_side = EMPTY;
+					bench_parse(p, s + last);
+					set_hash(p);
+				}
+				errors = bb_check(p, m, &nodes);
+				printf("Checked %d positions: %d differ.\n", nodes, errors);
+				if (s[last]) {
+					init_board(p);
+					open_book();
+				}
+			}
+#else
+			printf("This program was built without BITBOARD.\n");
+#endif
+			continue;
+		}
+		if (!strcmp(s, "perft")) {
+			int t;
+			U64 n, np;
+
+			fgets(s, 256, stdin);
+			m = 0;
+			last = 0;
+			sscanf(s, "%d %n", &m, &last);
+			if (m > MAX_PLY - 2)
+				m = MAX_PLY - 2;
+			if (s[last]) {
+				close_book();
+				computer_side = EMPTY;
+				bench_parse(p, s + last);
+				set_hash(p);
+			}
+			p->ply = 0;
+			t = get_ms();
+			n = perft(p, m);
+			printf("Perft %d: %llu positions in %d ms\n", m, n, get_ms() - t);
+			t = get_ms();
+			np = perft_pseudo(p, m);
+			printf("Pseudo-legal generator: %llu positions in %d ms%s\n", np,
+					get_ms() - t, np == n ? "" : " (they differ!)");
+			if (s[last]) {
+				init_board(p);
+				open_book();
+			}
+			else
+				gen(p);
+			continue;
+		}
+		if (!strcmp(s, "numa")) {
+			numa_print();
+			continue;
+		}
+		if (!strcmp(s, "hash")) {
+			scanf("%d", &m);
+			tt_init(m);
+			if (procs)
+				mp_init(procs);  /* so they share the new table */
+			printf("Hash table set to %d MB (%d entries).\n", m,
+					tt_size * TT_BUCKET);
+			continue;
+		}
 		if (!strcmp(s, "bye")) {
+			mp_stop();
+			net_disconnect();
 			printf("Share and enjoy!\n");
 			break;
 		}
@@ -191,12 +365,33 @@ int main()
 			printf("new - starts a new game\n");
 			printf("d - display the board\n");
 			printf("bench [fen] - benchmark built-in, or fen, position\n");
-			printf("p [e|q|r|v] - set parallel function (rest use serial)\n");
+			printf("bench all [fen] - compare search modes on a position\n");
+			printf("bench tune [fen] - pick split thresholds for p r, p v or p q\n");
+			printf("p [e|q|r|v|y|a|d|w|m|n|l] - set parallel function (rest use serial)\n");
 			printf("    e = parallel static evaluation\n");
 			printf("    q = parallel quiescence search\n");
 			printf("    r = parallel (root-splitting) alpha-beta search\n");
 			printf("    v = parallel (PV-splitting) alpha-beta search\n");
+			printf("    y = parallel (YBWC) alpha-beta search\n");
+			printf("    a = parallel (ABDADA) alpha-beta search\n");
+			printf("    d = parallel (DTS) alpha-beta search\n");
+			printf("    w = parallel aspiration window search\n");
+			printf("    m = multi-process root splitting (see procs)\n");
+			printf("    n = distributed PV splitting (see connect)\n");
+			printf("    l = Lazy SMP search\n");
 			printf("t n - set number of threads to n\n");
+			printf("split [d m n] - show, or set, the least depth, moves and nodes\n");
+			printf("    a node needs left to be split\n");
+			printf("procs n - start n worker processes for p m (0 = none)\n");
+			printf("serve port - work for a p n search on another machine\n");
+			printf("connect host port - add the worker at host:port for p n\n");
+			printf("disconnect - drop all the workers\n");
+			printf("bbcheck n [fen] - check the bitboard code against the mailbox\n");
+			printf("    to n ply from this, or fen, position (needs BITBOARD)\n");
+			printf("perft n [fen] - count the positions n ply from this, or fen,\n");
+			printf("    position, with gen() and the pseudo-legal generator\n");
+			printf("numa - show the NUMA nodes and where each thread runs\n");
+			printf("hash n - set hash table size to n MB (0 = off)\n");
 			printf("bye - exit the program\n");
 			printf("xboard - switch to XBoard mode\n");
 			printf("Enter moves in coordinate notation, e.g., e2e4, e7e8Q\n");
@@ -204,13 +399,14 @@ int main()
 		}
 
 		/* maybe the user entered a move? */
-		m = parse_move(s);
-		if (m == -1 || !makemove(gen_dat[m].m.b))
+		m = parse_move(p, s);
+		if (m == -1)
 			printf("Illegal move.\n");
 		else {
-			ply = 0;
-			gen();
-			print_result();
+			makemove(p, p->gen_dat[m].m.b);
+			p->ply = 0;
+			gen(p);
+			print_result(p);
 		}
 	}
 	close_book();
@@ -221,7 +417,7 @@ int main()
 /* parse the move s (in coordinate notation) and return the move's
    index in gen_dat, or -1 if the move is illegal */
 
-int parse_move(char *s)
+int parse_move(pos_t *p, char *s)
 {
 	int from, to, i;
 
@@ -237,13 +433,13 @@ int parse_move(char *s)
 	to = s[2] - 'a';
 	to += 8 * (8 - (s[3] - '0'));
 
-	for (i = 0; i < first_move[1]; ++i)
-		if (gen_dat[i].m.b.from == from && gen_dat[i].m.b.to == to) {
+	for (i = 0; i < p->first_move[1]; ++i)
+		if (p->gen_dat[i].m.b.from == from && p->gen_dat[i].m.b.to == to) {
 
 			/* if the move is a promotion, handle the promotion piece;
 			   assume that the promotion moves occur consecutively in
 			   gen_dat. */
-			if (gen_dat[i].m.b.bits & 32)
+			if (p->gen_dat[i].m.b.bits & 32)
 				switch (s[4]) {
 					case 'N':
 						return i;
@@ -304,21 +500,21 @@ char *move_str(move_bytes m)
 
 /* print_board() prints the board */
 
-void print_board()
+void print_board(pos_t *p)
 {
 	int i;
 	
 	printf("\n8 ");
 	for (i = 0; i < 64; ++i) {
-		switch (color[i]) {
+		switch (p->color[i]) {
 			case EMPTY:
 				printf(" .");
 				break;
 			case LIGHT:
-				printf(" %c", piece_char[piece[i]]);
+				printf(" %c", piece_char[p->piece[i]]);
 				break;
 			case DARK:
-				printf(" %c", piece_char[piece[i]] + ('a' - 'A'));
+				printf(" %c", piece_char[p->piece[i]] + ('a' - 'A'));
 				break;
 		}
 		if ((i + 1) % 8 == 0 && i != 63)
@@ -348,25 +544,26 @@ void xboard()
 	char line[256], command[256];
 	int m;
 	int post = 0;
+	pos_t *p = &pos_dat[0];
 
 	signal(SIGINT, SIG_IGN);
 	printf("\n");
-	init_board();
-	gen();
+	init_board(p);
+	gen(p);
 	computer_side = EMPTY;
 	for (;;) {
 		fflush(stdout);
-		if (side == computer_side) {
-			think(post);
-			if (!pv[0][0].u) {
+		if (p->side == computer_side) {
+			think(p, post);
+			if (!p->pv[0][0].u) {
 				computer_side = EMPTY;
 				continue;
 			}
-			printf("move %s\n", move_str(pv[0][0].b));
-			makemove(pv[0][0].b);
-			ply = 0;
-			gen();
-			print_result();
+			printf("move %s\n", move_str(p->pv[0][0].b));
+			makemove(p, p->pv[0][0].b);
+			p->ply = 0;
+			gen(p);
+			print_result(p);
 			continue;
 		}
 		if (!fgets(line, 256, stdin))
@@ -377,8 +574,9 @@ void xboard()
 		if (!strcmp(command, "xboard"))
 			continue;
 		if (!strcmp(command, "new")) {
-			init_board();
-			gen();
+			init_board(p);
+			tt_clear();
+			gen(p);
 			computer_side = DARK;
 			continue;
 		}
@@ -389,16 +587,16 @@ void xboard()
 			continue;
 		}
 		if (!strcmp(command, "white")) {
-			side = LIGHT;
-			xside = DARK;
-			gen();
+			p->side = LIGHT;
+			p->xside = DARK;
+			gen(p);
 			computer_side = DARK;
 			continue;
 		}
 		if (!strcmp(command, "black")) {
-			side = DARK;
-			xside = LIGHT;
-			gen();
+			p->side = DARK;
+			p->xside = LIGHT;
+			gen(p);
 			computer_side = LIGHT;
 			continue;
 		}
@@ -420,35 +618,42 @@ void xboard()
 			max_depth = 32;
 			continue;
 		}
+		if (!strcmp(command, "hash")) {
+			sscanf(line, "hash %d", &m);
+			tt_init(m);
+			if (procs)
+				mp_init(procs);
+			continue;
+		}
 		if (!strcmp(command, "otim")) {
 			continue;
 		}
 		if (!strcmp(command, "go")) {
-			computer_side = side;
+			computer_side = p->side;
 			continue;
 		}
 		if (!strcmp(command, "hint")) {
-			think(0);
-			if (!pv[0][0].u)
+			think(p, 0);
+			if (!p->pv[0][0].u)
 				continue;
-			printf("Hint: %s\n", move_str(pv[0][0].b));
+			printf("Hint: %s\n", move_str(p->pv[0][0].b));
 			continue;
 		}
 		if (!strcmp(command, "undo")) {
-			if (!hply)
+			if (!p->hply)
 				continue;
-			takeback();
-			ply = 0;
-			gen();
+			takeback(p);
+			p->ply = 0;
+			gen(p);
 			continue;
 		}
 		if (!strcmp(command, "remove")) {
-			if (hply < 2)
+			if (p->hply < 2)
 				continue;
-			takeback();
-			takeback();
-			ply = 0;
-			gen();
+			takeback(p);
+			takeback(p);
+			p->ply = 0;
+			gen(p);
 			continue;
 		}
 		if (!strcmp(command, "post")) {
@@ -459,13 +664,14 @@ void xboard()
 			post = 0;
 			continue;
 		}
-		m = parse_move(line);
-		if (m == -1 || !makemove(gen_dat[m].m.b))
+		m = parse_move(p, line);
+		if (m == -1)
 			printf("Error (unknown command): %s\n", command);
 		else {
-			ply = 0;
-			gen();
-			print_result();
+			makemove(p, p->gen_dat[m].m.b);
+			p->ply = 0;
+			gen(p);
+			print_result(p);
 		}
 	}
 }
@@ -474,19 +680,12 @@ void xboard()
 /* print_result() checks to see if the game is over, and if so,
    prints the result. */
 
-void print_result()
+void print_result(pos_t *p)
 {
-	int i;
-
-	/* is there a legal move? */
-	for (i = 0; i < first_move[1]; ++i)
-		if (makemove(gen_dat[i].m.b)) {
-			takeback();
-			break;
-		}
-	if (i == first_move[1]) {
-		if (in_check(side)) {
-			if (side == LIGHT)
+	/* is there a legal move? (gen() only generates legal ones) */
+	if (p->first_move[1] == p->first_move[0]) {
+		if (in_check(p, p->side)) {
+			if (p->side == LIGHT)
 				printf("0-1 {Black mates}\n");
 			else
 				printf("1-0 {White mates}\n");
@@ -494,13 +693,26 @@ void print_result()
 		else
 			printf("1/2-1/2 {Stalemate}\n");
 	}
-	else if (reps() == 3)
+	else if (reps(p) == 3)
 		printf("1/2-1/2 {Draw by repetition}\n");
-	else if (fifty >= 100)
+	else if (p->fifty >= 100)
 		printf("1/2-1/2 {Draw by fifty move rule}\n");
 }
 
 
+/* print_tt_hits() prints how often the last search's probes hit in
+   the threads' local hash tables, and how often the rest hit in the
+   shared one. */
+
+void print_tt_hits()
+{
+	int local, shared;
+
+	tt_hits(&local, &shared);
+	printf("Hash hits: %d%% local, %d%% of the rest shared\n", local, shared);
+}
+
+
 /* bench_default: sets position to move 17 of Bobby Fischer vs. J. Sherwin,
    New Jersey State Open Championship, 9/2/1957. */
 
@@ -526,20 +738,21 @@ int bench_piece[64] = {
 	3, 6, 2, 6, 3, 6, 5, 6
 };
 
-void bench_default() {
+void bench_default(pos_t *p) {
 	int i;
 	
 	for (i = 0; i < 64; ++i) {
-		color[i] = bench_color[i];
-		piece[i] = bench_piece[i];
+		p->color[i] = bench_color[i];
+		p->piece[i] = bench_piece[i];
 	}
-	side = LIGHT;
-	xside = DARK;
-	castle = 0;
-	ep = -1;
-	fifty = 0;
-	ply = 0;
-	hply = 0;
+	p->side = LIGHT;
+	p->xside = DARK;
+	p->castle = 0;
+	p->ep = -1;
+	p->fifty = 0;
+	p->ply = 0;
+	p->hply = 0;
+	plist_set(p);
 }
 
 
@@ -547,19 +760,28 @@ void bench_default() {
    It calls bench_default() instead if there is an "obvious" error 
    (though it does not attempt to catch all errors). */
 
-void bench_parse(char *fen) {
+void bench_parse(pos_t *p, char *fen) {
+	if (!fen_parse(p, fen))
+		bench_default(p);
+	else
+		printf("Loaded: %s\n", fen);
+}
+
+
+/* fen_parse: does the work for bench_parse(). It returns FALSE if
+   fen has an "obvious" error, leaving the board in a mess. */
+
+BOOL fen_parse(pos_t *p, char *fen) {
 	char *pch, ch, next_ch;
 	int sq, offset;
 	
 	// board array setup
-	if (fen == NULL || (pch = strtok(fen, " ")) == NULL) {
-		bench_default();
-		return;
-	}
+	if (fen == NULL || (pch = strtok(fen, " ")) == NULL)
+		return FALSE;
 	
 	for (sq = 0; sq < 64; sq++) {
-		color[sq] = EMPTY;
-		piece[sq] = EMPTY;
+		p->color[sq] = EMPTY;
+		p->piece[sq] = EMPTY;
 	}
 	
 	sq = A8;
@@ -574,87 +796,82 @@ void bench_parse(char *fen) {
 				break;
 			sq += offset;
 		} else {
-			color[sq] = isupper(ch) ? LIGHT : DARK;
+			p->color[sq] = isupper(ch) ? LIGHT : DARK;
 			switch (tolower(ch)) {
 			case 'p':
-				piece[sq] = PAWN;
+				p->piece[sq] = PAWN;
 				break;
 			case 'n':
-				piece[sq] = KNIGHT;
+				p->piece[sq] = KNIGHT;
 				break;
 			case 'b':
-				piece[sq] = BISHOP;
+				p->piece[sq] = BISHOP;
 				break;
 			case 'r':
-				piece[sq] = ROOK;
+				p->piece[sq] = ROOK;
 				break;
 			case 'q':
-				piece[sq] = QUEEN;
+				p->piece[sq] = QUEEN;
 				break;
 			case 'k':
-				piece[sq] = KING;
+				p->piece[sq] = KING;
 				break;
 			}
-			if (piece[sq] == EMPTY)
+			if (p->piece[sq] == EMPTY)
 				break;
 			sq++;
 		}
 	}
 	if (ch != '\0' || sq != 64) { // interrupted by error, or board not filled
-		print_board();
+		print_board(p);
 		printf("FEN board parse error: char = %c, square = %d.\n", ch, sq);
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
 	// side to move setup
 	if ((pch = strtok(NULL, " ")) == NULL) {
 		printf("FEN string lacks side to move descriptor.\n");
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
 	ch = *pch;	
 	if (ch == 'w') {
-		side = LIGHT;
-		xside = DARK;
+		p->side = LIGHT;
+		p->xside = DARK;
 	} else if (ch == 'b') {		
-		side = DARK;
-		xside = LIGHT;
+		p->side = DARK;
+		p->xside = LIGHT;
 	} else {
 		printf("FEN invalid side to move argument: %c.\n", ch);
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
 	// castling setup
 	if ((pch = strtok(NULL, " ")) == NULL) {
 		printf("FEN string lacks castling descriptor.\n");
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
-	castle = 0;
+	p->castle = 0;
 	
 	if (*pch != '-') {
 		while ((ch = *pch++) != '\0') {
 			switch (ch) {
 			case 'K':
-				castle |= 1;
+				p->castle |= 1;
 				break;
 			case 'Q':
-				castle |= 2;
+				p->castle |= 2;
 				break;
 			case 'k':
-				castle |= 4;
+				p->castle |= 4;
 				break;
 			case 'q':
-				castle |= 8;
+				p->castle |= 8;
 				break;
 			default:
 				printf("FEN invalid castling argument: %c.\n", ch);
-				bench_default();
-				return;
+				return FALSE;
 			}
 		}
 	}
@@ -662,58 +879,124 @@ void bench_parse(char *fen) {
 	// en passant setup
 	if ((pch = strtok(NULL, " ")) == NULL) {
 		printf("FEN string lacks en passant descriptor.\n");
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
-	ep = -1;
+	p->ep = -1;
 	
 	if (*pch != '-') {
 		ch = *pch;
 		next_ch = *(pch + 1);
 		if (ch < 'a' || 'h' < ch || next_ch < '1' || '8' < next_ch) {
 			printf("FEN invalid en passant string: %c%c.\n", ch, next_ch);
-			bench_default();
-			return;
+			return FALSE;
 		}
-		ep = (ch - 'a') + ('8' - next_ch) * 8;
+		p->ep = (ch - 'a') + ('8' - next_ch) * 8;
 	}
 	
 	// half move clock setup
 	if ((pch = strtok(NULL, " ")) == NULL) {
 		printf("FEN string lacks half move clock descriptor.\n");
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
-	fifty = atoi(pch);
+	p->fifty = atoi(pch);
 	
-	if (fifty < 0) {
-		printf("FEN invalid half move clock value: %d.\n", fifty);
-		bench_default();
-		return;
+	if (p->fifty < 0) {
+		printf("FEN invalid half move clock value: %d.\n", p->fifty);
+		return FALSE;
 	}
+	if (p->fifty > 255)  /* see hist_t */
+		p->fifty = 255;
 	
 	// full move clock setup	
 	if ((pch = strtok(NULL, " ")) == NULL) {
 		printf("FEN string lacks full moves descriptor.\n");
-		bench_default();
-		return;
+		return FALSE;
 	}
 	
-	ply = 0;
-	hply = atoi(pch);
+	p->ply = 0;
+	p->hply = atoi(pch);
 	
-	if (hply < 1) {
-		printf("FEN invalid full moves value: %d.\n", hply);
-		bench_default();
-		return;
+	if (p->hply < 1) {
+		printf("FEN invalid full moves value: %d.\n", p->hply);
+		return FALSE;
 	}
 	
-	printf("Loaded: %s\n", fen);
+	plist_set(p);
+	return TRUE;
+}
+
+
+/* fen_str: writes position p to s in FEN notation. The full move
+   number isn't kept track of, so it's always 1. */
+
+void fen_str(pos_t *p, char *s) {
+	int sq, n = 0;
+
+	for (sq = 0; sq < 64; ++sq) {
+		if (p->color[sq] == EMPTY)
+			++n;
+		else {
+			if (n)
+				*s++ = '0' + n;
+			n = 0;
+			*s++ = p->color[sq] == LIGHT ? piece_char[p->piece[sq]] :
+					tolower(piece_char[p->piece[sq]]);
+		}
+		if (COL(sq) == 7) {
+			if (n)
+				*s++ = '0' + n;
+			n = 0;
+			if (sq != 63)
+				*s++ = '/';
+		}
+	}
+	*s++ = ' ';
+	*s++ = p->side == LIGHT ? 'w' : 'b';
+	*s++ = ' ';
+	if (!p->castle)
+		*s++ = '-';
+	if (p->castle & 1)
+		*s++ = 'K';
+	if (p->castle & 2)
+		*s++ = 'Q';
+	if (p->castle & 4)
+		*s++ = 'k';
+	if (p->castle & 8)
+		*s++ = 'q';
+	*s++ = ' ';
+	if (p->ep == -1)
+		*s++ = '-';
+	else {
+		*s++ = 'a' + COL(p->ep);
+		*s++ = '8' - ROW(p->ep);
+	}
+	sprintf(s, " %d 1", p->fifty);
 }
 
 
+/* the search modes compared by bench_all() */
+
+struct {
+	char *name;
+	void (*iterate)(pos_t *, int);
+	int (*search)(pos_t *, int, int, int);
+} bench_modes[] = {
+	{ "serial", &iterate, &search },
+	{ "p r", &iterate, &prs_search },
+	{ "p v", &iterate, &pvs_search },
+	{ "p y", &iterate, &ybw_search },
+	{ "p a", &iterate, &abdada_search },
+	{ "p d", &iterate, &dts_search },
+	{ "p w", &iterate, &aspire_search },
+	{ "p l", &lazy_iterate, &search },
+	{ "p m", &iterate, &mp_search },  /* only with worker processes */
+	{ "p n", &iterate, &net_search },  /* only with workers connected */
+	{ NULL, NULL, NULL }
+};
+
+
 /* bench: This is a little benchmark code that calculates how many
    nodes per second TSCP searches.
    Then it searches iterations times. It calculates nodes per
@@ -724,27 +1007,33 @@ void bench(char *fen, int iterations)
 	int i, best_time, best_nodes;
 	int t[iterations];
 	double nps;
+	pos_t *p = &pos_dat[0];
 
 	/* setting the position to a non-initial position confuses the opening
 	   book code. */
 	close_book();
 
-	bench_parse(fen); // set up board
+	bench_parse(p, fen); // set up board
 
-	set_hash();
-	print_board();
+	set_hash(p);
+	print_board(p);
 	// max_time = 1 << 25;
 	// max_depth = 5;
 	for (i = 0; i < iterations; ++i) {
-		think(1);
+		tt_clear();
+		think(p, 1);
 		t[i] = get_ms() - start_time;
 		if (t[i] < best_time) {
 			best_time = t[i];
-			best_nodes = nodes;
+			best_nodes = node_count();
 		}
-		nps = (double)nodes / (double)t[0] * 1000;
+		nps = (double)node_count() / (double)t[0] * 1000;
 		printf("Time: %d ms\n", t[i]);
-		printf("Nodes: %d (%d per second)\n", nodes, (int)nps);
+		if (stop_latency >= 0)
+			printf("Stop latency: %d us\n", stop_latency);
+		printf("Nodes: %d (%d per second)\n", node_count(), (int)nps);
+		printf("Hash full: %d/1000\n", tt_hashfull());
+		print_tt_hits();
 	}
 	if (!ftime_ok) {
 		printf("\n");
@@ -762,14 +1051,142 @@ void bench(char *fen, int iterations)
 			printf("(invalid)\n");
 			return;
 		}
-		nps = (double)nodes / (double)t[i];
+		nps = (double)node_count() / (double)t[i];
 		nps *= 1000.0;
 
 		/* Score: 1.000 = my Athlon XP 2000+ */
 		printf("Nodes per second: %d (Score: %.3f)\n", (int)nps, (float)nps/243169.0);
 	}
 
-	init_board();
+	init_board(p);
+	open_book();
+	gen(p);
+}
+
+
+/* bench_all: searches the position once with each of the search modes
+   in bench_modes (with serial evaluation and quiescence search), then
+   prints each one's time to depth and speedup over the serial search. */
+
+void bench_all(char *fen)
+{
+	char buf[256];
+	int i;
+	int t[sizeof(bench_modes) / sizeof(bench_modes[0])];
+	int n[sizeof(bench_modes) / sizeof(bench_modes[0])];
+	int x[sizeof(bench_modes) / sizeof(bench_modes[0])];
+	int (*old_eval)(pos_t *) = eval_func;
+	int (*old_quiesce)(pos_t *, int, int) = quiesce_func;
+	int (*old_search)(pos_t *, int, int, int) = search_func;
+	void (*old_iterate)(pos_t *, int) = iterate_func;
+	pos_t *p = &pos_dat[0];
+
+	close_book();
+	eval_func = &eval;
+	quiesce_func = &quiesce;
+	for (i = 0; bench_modes[i].name; ++i) {
+		t[i] = -1;
+		if ((bench_modes[i].search == &mp_search && !procs) ||
+				(bench_modes[i].search == &net_search && !net_workers))
+			continue;
+		strcpy(buf, fen);
+		bench_parse(p, buf);
+		set_hash(p);
+		printf("\n%s, %d threads:\n", bench_modes[i].name, threads);
+		iterate_func = bench_modes[i].iterate;
+		search_func = bench_modes[i].search;
+		tt_clear();
+		think(p, 1);
+		t[i] = get_ms() - start_time;
+		n[i] = node_count();
+		x[i] = search_score;
+	}
+
+	/* every mode should get the serial search's score; one that
+	   doesn't is marked */
+	printf("\nmode     time (ms)       nodes  speedup  score\n");
+	for (i = 0; bench_modes[i].name; ++i)
+		if (t[i] != -1)
+			printf("%-6s  %10d  %10d  %7.2f  %5d%s\n", bench_modes[i].name,
+					t[i], n[i], t[i] ? (double)t[0] / t[i] : 0.0, x[i],
+					x[i] != x[0] ? " (differs!)" : "");
+
+	eval_func = old_eval;
+	quiesce_func = old_quiesce;
+	search_func = old_search;
+	iterate_func = old_iterate;
+	init_board(p);
+	open_book();
+	gen(p);
+}
+
+
+/* bench_tune: picks the split thresholds for the current search mode
+   on this machine. First it measures how many nodes the serial search
+   does in the time it takes to split a node, and sets split_nodes so a
+   split has to be worth SPLIT_WORTH times that. Then it tries each
+   split_depth from 0 to 5 on the position and keeps the fastest. Only
+   the pool's split is timed, so only the modes that use the pool (p r,
+   p v and p q) are tuned; YBWC and DTS split in their own ways. */
+
+#define SPLIT_WORTH		20
+
+void bench_tune(char *fen)
+{
+	char buf[256];
+	int i, t, cost, best_depth, best_time = 0;
+	double rate;
+	int (*old_search)(pos_t *, int, int, int) = search_func;
+	void (*old_iterate)(pos_t *, int) = iterate_func;
+	pos_t *p = &pos_dat[0];
+
+	if (!pool_mode()) {
+		printf("bench tune only tunes p r, p v and p q.\n");
+		return;
+	}
+	close_book();
+	strcpy(buf, fen);
+	bench_parse(p, buf);
+	set_hash(p);
+
+	/* how fast is the serial search, and how slow is a split? */
+	search_func = &search;
+	iterate_func = &iterate;
+	tt_clear();
+	think(p, 0);
+	t = get_ms() - start_time;
+	rate = (double)node_count() / (t ? t : 1);
+	search_func = old_search;
+	iterate_func = old_iterate;
+	cost = pool_cost(10000);
+	split_nodes = (int)(SPLIT_WORTH * cost * rate / 1000000.0);
+	if (split_nodes < 1)
+		split_nodes = 1;
+	printf("Serial search: %d nodes per ms\n", (int)rate);
+	printf("Split cost: %d ns with %d threads\n", cost, threads);
+
+	printf("\ndepth   time (ms)       nodes\n");
+	best_depth = split_depth;
+	for (i = 0; i <= 5; ++i) {
+		split_depth = i;
+		memset(split_size, 0, sizeof(split_size));
+		strcpy(buf, fen);
+		bench_parse(p, buf);
+		set_hash(p);
+		tt_clear();
+		think(p, 0);
+		t = get_ms() - start_time;
+		printf("%5d  %10d  %10d\n", i, t, node_count());
+		if (i == 0 || t < best_time) {
+			best_depth = i;
+			best_time = t;
+		}
+	}
+	split_depth = best_depth;
+	printf("\nSplitting with at least %d ply, %d moves and %d nodes left.\n",
+			split_depth, split_moves, split_nodes);
+
+	init_board(p);
 	open_book();
-	gen();
+	gen(p);
 }
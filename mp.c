@@ -0,0 +1,426 @@
+/*
+ *	MP.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This is a parallel search with processes instead of threads.
+   mp_init() moves the transposition table into shared memory and forks
+   the worker processes, which all use it. mp_search() then splits the
+   root node across the workers the way prs_search() splits it across
+   threads: each idle worker is sent the position and a root move over
+   a pipe, searches the move serially, and sends its score and PV back
+   over another pipe. The coordinator (the process the user talks to)
+   only hands out moves and collects the results. */
+
+int mp_cmd[MAX_THREADS];  /* the pipes jobs are sent on (-1 if the worker died)... */
+int mp_res[MAX_THREADS];  /* ...and results come back on */
+pid_t mp_pid[MAX_THREADS];
+int mp_move[MAX_THREADS];  /* the root move a worker's searching, or -1 */
+
+
+/* mp_init() (re)starts n worker processes. */
+
+void mp_init(int n)
+{
+	int i, j, cmd[2], res[2];
+
+	mp_stop();
+	if (n > MAX_THREADS)
+		n = MAX_THREADS;
+	if (n > 0 && !tt_share()) {
+		printf("The hash table couldn't be put in shared memory.\n");
+		n = 0;
+	}
+	signal(SIGPIPE, SIG_IGN);  /* a dead worker shouldn't kill us */
+	fflush(stdout);
+	for (i = 0; i < n; ++i) {
+		if (pipe(cmd))
+			break;
+		if (pipe(res)) {
+			close(cmd[0]);
+			close(cmd[1]);
+			break;
+		}
+		mp_pid[i] = fork();
+		if (mp_pid[i] == 0) {
+
+			/* the worker mustn't hold the other workers' pipes
+			   open, or they wouldn't see the end of theirs */
+			for (j = 0; j < i; ++j) {
+				close(mp_cmd[j]);
+				close(mp_res[j]);
+			}
+			close(cmd[1]);
+			close(res[0]);
+			mp_worker(cmd[0], res[1]);
+		}
+		close(cmd[0]);
+		close(res[1]);
+		if (mp_pid[i] < 0) {
+			close(cmd[1]);
+			close(res[0]);
+			break;
+		}
+		mp_cmd[i] = cmd[1];
+		mp_res[i] = res[0];
+		mp_move[i] = -1;
+	}
+	procs = i;
+}
+
+
+/* mp_stop() stops the worker processes. Closing a worker's job pipe
+   tells it to exit. */
+
+void mp_stop()
+{
+	int i;
+
+	for (i = 0; i < procs; ++i) {
+		if (mp_cmd[i] < 0)
+			continue;  /* see mp_drop() */
+		close(mp_cmd[i]);
+		close(mp_res[i]);
+		waitpid(mp_pid[i], NULL, 0);
+	}
+	procs = 0;
+}
+
+
+/* mp_worker() is a worker process's main loop: it searches the jobs
+   that come in on pipe in and writes the results to pipe out, until
+   the coordinator closes in. It uses only the serial search
+   functions. */
+
+void mp_worker(int in, int out)
+{
+	int j, x;
+	mp_job job;
+	mp_result r;
+	pos_t *p = &pos_dat[0];
+
+	threads = 1;
+	procs = 0;
+	eval_func = &eval;
+	quiesce_func = &quiesce;
+	numa_unpin();
+	timer_init();
+	while (mp_read(in, &job, sizeof(job))) {
+		memcpy(p->color, job.color, sizeof(p->color));
+		memcpy(p->piece, job.piece, sizeof(p->piece));
+		plist_set(p);
+		p->side = job.side;
+		p->xside = job.xside;
+		p->castle = job.castle;
+		p->ep = job.ep;
+		p->fifty = job.fifty;
+		p->hply = job.hply;
+		if (!mp_read(in, p->hist_dat, job.hply * sizeof(hist_t)))
+			break;
+		p->ply = 0;
+		p->first_move[0] = 0;
+		p->first_move[1] = 0;
+		p->follow_pv = FALSE;
+		p->split = NULL;
+		p->nodes = 0;
+		set_hash(p);
+		tt_age = job.age;
+
+		stop_search.val = FALSE;
+		timer_start(job.ms);
+		makemove(p, job.m.b);
+		x = -search(p, -job.beta, -job.alpha, job.depth - 1);
+		takeback(p);
+		timer_stop();
+
+		r.stopped = stop_search.val;
+		r.score = x;
+		r.nodes = p->nodes;
+		r.pv_length = p->pv_length[1] - 1;
+		for (j = 0; j < r.pv_length; ++j)
+			r.pv[j] = p->pv[1][j + 1];
+		if (!mp_write(out, &r, sizeof(r)))
+			break;
+	}
+	_exit(0);
+}
+
+
+/* mp_search() does search by splitting the root node across the
+   worker processes. Anywhere else, or without any workers, it's just
+   search(). */
+
+int mp_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, k, x, busy, next;
+	BOOL c, f, cut;
+	move best, hash_move;
+	mp_result r;
+
+	if (!procs || p->ply || !depth)
+		return search(p, alpha, beta, depth);
+
+	++p->nodes;
+	p->pv_length[0] = 0;
+
+	/* are we in check? if so, we want to search deeper */
+	c = in_check(p, p->side);
+	if (c)
+		++depth;
+
+	/* at the root we have to pick a move, so we only use the
+	   table's move */
+	tt_probe(p, depth, alpha, beta, &x, &hash_move);
+	gen(p);
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+	for (i = p->first_move[0]; i < p->first_move[1]; ++i)
+		sort(p, i);
+
+	f = FALSE;
+	cut = FALSE;
+	best.u = 0;
+	busy = 0;
+	next = p->first_move[0];
+	for (;;) {
+
+		/* give every idle worker the next legal move. one that can't
+		   be sent to its worker (it died) is searched here */
+		for (k = 0; k < procs && !cut && !stop_search.val; ++k) {
+			if (mp_cmd[k] < 0 || mp_move[k] != -1)
+				continue;
+			if (next >= p->first_move[1])
+				break;
+			f = TRUE;
+			i = next++;
+			if (mp_send(p, k, i, alpha, beta, depth))
+				++busy;
+			else {
+				mp_local(p, i, alpha, beta, depth, &r);
+				alpha = mp_merge(p, i, &r, alpha, beta, depth, &best, &cut);
+			}
+		}
+
+		/* with no workers left, search the rest of the moves here */
+		if (!busy) {
+			if (next >= p->first_move[1] || cut || stop_search.val)
+				break;
+			f = TRUE;
+			i = next++;
+			mp_local(p, i, alpha, beta, depth, &r);
+			alpha = mp_merge(p, i, &r, alpha, beta, depth, &best, &cut);
+			continue;
+		}
+
+		/* wait for a worker to finish, and merge its result */
+		k = mp_wait(&r);
+		i = mp_move[k];
+		mp_move[k] = -1;
+		--busy;
+		if (mp_cmd[k] < 0) {  /* it died, so search its move here */
+			if (stop_search.val || cut)
+				continue;
+			mp_local(p, i, alpha, beta, depth, &r);
+		}
+		p->nodes += r.nodes;
+		if (r.stopped)
+			stop_search.val = TRUE;  /* its clock just beat ours */
+		alpha = mp_merge(p, i, &r, alpha, beta, depth, &best, &cut);
+	}
+	if (stop_search.val)
+		return alpha;
+	if (cut) {
+		tt_store(p, depth, beta, TT_LOWER, best);
+		return beta;
+	}
+
+	/* no legal moves? then we're in checkmate or stalemate */
+	if (!f) {
+		if (c)
+			return -10000;
+		else
+			return 0;
+	}
+
+	/* fifty move draw rule */
+	if (p->fifty >= 100)
+		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
+	return alpha;
+}
+
+
+/* mp_merge() merges the result r of root move i into mp_search()'s
+   alpha, best, cut and PV, and returns the new alpha. */
+
+int mp_merge(pos_t *p, int i, mp_result *r, int alpha, int beta,
+		int depth, move *best, BOOL *cut)
+{
+	int j;
+
+	if (stop_search.val || *cut || r->score <= alpha)
+		return alpha;
+	p->history[(int)p->gen_dat[i].m.b.from][(int)p->gen_dat[i].m.b.to] += depth;
+	*best = p->gen_dat[i].m;
+	if (r->score >= beta) {
+		*cut = TRUE;
+		return alpha;
+	}
+	p->pv[0][0] = *best;
+	for (j = 0; j < r->pv_length; ++j)
+		p->pv[0][j + 1] = r->pv[j];
+	p->pv_length[0] = r->pv_length + 1;
+	return r->score;
+}
+
+
+/* mp_local() searches root move i here, for a move whose worker died,
+   and puts the result in r as a worker would. */
+
+void mp_local(pos_t *p, int i, int alpha, int beta, int depth,
+		mp_result *r)
+{
+	int j;
+
+	makemove(p, p->gen_dat[i].m.b);
+	r->score = -search(p, -beta, -alpha, depth - 1);
+	takeback(p);
+	r->stopped = FALSE;
+	r->nodes = 0;  /* they're counted in p->nodes already */
+	r->pv_length = p->pv_length[1] - 1;
+	for (j = 0; j < r->pv_length; ++j)
+		r->pv[j] = p->pv[1][j + 1];
+}
+
+
+/* mp_send() sends worker k move i of position p to search with the
+   given window and depth, in whatever time the search has left. If
+   the worker died, it's dropped, and mp_send() returns FALSE. */
+
+BOOL mp_send(pos_t *p, int k, int i, int alpha, int beta, int depth)
+{
+	mp_job job;
+
+	memcpy(job.color, p->color, sizeof(job.color));
+	memcpy(job.piece, p->piece, sizeof(job.piece));
+	job.side = p->side;
+	job.xside = p->xside;
+	job.castle = p->castle;
+	job.ep = p->ep;
+	job.fifty = p->fifty;
+	job.hply = p->hply;
+	job.m = p->gen_dat[i].m;
+	job.alpha = alpha;
+	job.beta = beta;
+	job.depth = depth;
+	job.age = tt_age;
+	job.ms = max_time - (get_ms() - start_time);
+	if (job.ms < 1)
+		job.ms = 1;
+	if (!mp_write(mp_cmd[k], &job, sizeof(job)) ||
+			!mp_write(mp_cmd[k], p->hist_dat, p->hply * sizeof(hist_t))) {
+		mp_drop(k);
+		return FALSE;
+	}
+	mp_move[k] = i;
+	return TRUE;
+}
+
+
+/* mp_drop() closes the pipes of worker k, which has died, and says
+   so. It isn't sent any more moves. */
+
+void mp_drop(int k)
+{
+	close(mp_cmd[k]);
+	close(mp_res[k]);
+	waitpid(mp_pid[k], NULL, 0);
+	mp_cmd[k] = -1;
+	printf("Lost worker process %d; searching its moves here.\n", k);
+}
+
+
+/* mp_wait() waits for a busy worker to send its result, reads it into
+   r, and returns the worker's index. If the worker died, it's dropped
+   (see mp_drop()), and its move is left for the caller to search. */
+
+int mp_wait(mp_result *r)
+{
+	int k, n;
+	struct pollfd fds[MAX_THREADS];
+	int who[MAX_THREADS];
+
+	for (;;) {
+		n = 0;
+		for (k = 0; k < procs; ++k)
+			if (mp_move[k] != -1) {
+				fds[n].fd = mp_res[k];
+				fds[n].events = POLLIN;
+				who[n++] = k;
+			}
+		if (poll(fds, n, -1) <= 0)
+			continue;
+		for (k = 0; k < n; ++k)
+			if (fds[k].revents) {
+				if (!mp_read(mp_res[who[k]], r, sizeof(*r)))
+					mp_drop(who[k]);
+				return who[k];
+			}
+	}
+}
+
+
+/* mp_read() reads n bytes from fd into buf. It returns FALSE if the
+   other end was closed first. */
+
+BOOL mp_read(int fd, void *buf, int n)
+{
+	int i;
+	char *b = buf;
+
+	while (n > 0) {
+		i = read(fd, b, n);
+		if (i <= 0)
+			return FALSE;
+		b += i;
+		n -= i;
+	}
+	return TRUE;
+}
+
+
+/* mp_write() writes n bytes from buf to fd. It returns FALSE if the
+   other end was closed. */
+
+BOOL mp_write(int fd, void *buf, int n)
+{
+	int i;
+	char *b = buf;
+
+	while (n > 0) {
+		i = write(fd, b, n);
+		if (i <= 0)
+			return FALSE;
+		b += i;
+		n -= i;
+	}
+	return TRUE;
+}
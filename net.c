@@ -0,0 +1,569 @@
+/*
+ *	NET.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#define _POSIX_C_SOURCE 200112L  /* for getaddrinfo() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This spreads a search over other machines. An engine started with
+   "serve port" is a worker: it waits for a master to connect, and
+   searches whatever moves it's sent. The master connects to workers
+   with "connect host port", and its net_search() (p n) is PV splitting
+   like pvs_search(), except that the moves after a PV node's first one
+   are sent to the workers instead of the thread pool. Everything goes
+   over TCP as lines of text:
+
+   job alpha beta depth ply ms move|fen|moves
+	   search move from the position reached by playing moves (from
+	   the root of the master's search) from fen, with the window
+	   (alpha, beta), depth ply left and ms milliseconds to do it in.
+	   ply is the master's ply at the move, so that mate scores come
+	   back relative to the master's root
+   stop
+	   stop searching; the master doesn't need the result any more
+   result stopped score nodes from,to,promote,bits ...
+	   a worker's score for the last job, with its node count and
+	   the PV after the job's move. If stopped is 1, the search was
+	   stopped and score means nothing.
+
+   A worker searches with the serial search functions, and has its own
+   transposition table. */
+
+#define NET_MIN_DEPTH	3  /* don't send out moves with less depth than this */
+#define NET_LINE		2048
+
+int net_fd[MAX_THREADS];  /* the master's connections to workers... */
+FILE *net_in[MAX_THREADS];
+int net_move[MAX_THREADS];  /* ...and the move each is searching, or -1 */
+char net_fen[128];  /* the root of the master's search */
+
+int net_out;  /* a worker's connection to its master */
+char net_job[NET_LINE];  /* the job the worker's searching */
+
+
+/* net_connect() connects to the worker at host:port. It returns FALSE
+   if it couldn't. */
+
+BOOL net_connect(char *host, char *port)
+{
+	int fd = -1, one = 1;
+	struct addrinfo hints, *res, *a;
+
+	if (net_workers >= MAX_THREADS)
+		return FALSE;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port, &hints, &res))
+		return FALSE;
+	for (a = res; a; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if (fd < 0)
+			continue;
+		if (!connect(fd, a->ai_addr, a->ai_addrlen))
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		return FALSE;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	signal(SIGPIPE, SIG_IGN);  /* a dead worker shouldn't kill us */
+	net_fd[net_workers] = fd;
+	net_in[net_workers] = fdopen(fd, "r");
+	net_move[net_workers] = -1;
+	++net_workers;
+	return TRUE;
+}
+
+
+/* net_disconnect() closes the connections to all the workers, which
+   then wait for another master. */
+
+void net_disconnect()
+{
+	int i;
+
+	for (i = 0; i < net_workers; ++i)
+		if (net_fd[i] >= 0)
+			fclose(net_in[i]);
+	net_workers = 0;
+}
+
+
+/* net_search() does search in parallel via principal variation
+   splitting across the workers. Near the leaves, or without any
+   workers, it's just search(). */
+
+int net_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, i0, j, x;
+	BOOL c, f, cut;
+	move best, hash_move;
+
+	if (!net_workers || depth < NET_MIN_DEPTH)
+		return search(p, alpha, beta, depth);
+	if (!p->ply)
+		fen_str(p, net_fen);
+
+	++p->nodes;
+
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
+		return alpha;
+
+	p->pv_length[p->ply] = p->ply;
+
+	/* if this isn't the root of the search tree (where we have
+	   to pick a move and can't simply return 0) then check to
+	   see if the position is a repeat. if so, we can assume that
+	   this line is a draw and return 0. */
+	if (p->ply && reps(p))
+		return 0;
+
+	/* are we too deep? */
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
+
+	/* are we in check? if so, we want to search deeper */
+	c = in_check(p, p->side);
+	if (c)
+		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
+
+	gen(p);
+
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+
+	f = FALSE;
+	best.u = 0;
+
+	/* search the first (PV) move here, before sending out the rest */
+	for (i0 = p->first_move[p->ply]; i0 < p->first_move[p->ply + 1]; ++i0) {
+		sort(p, i0);
+		makemove(p, p->gen_dat[i0].m.b);
+		f = TRUE;
+		x = -net_search(p, -beta, -alpha, depth - 1);
+		takeback(p);
+		if (stop_search.val)
+			return alpha;
+		if (x > alpha) {
+			p->history[(int)p->gen_dat[i0].m.b.from][(int)p->gen_dat[i0].m.b.to] += depth;
+			if (x >= beta) {
+				tt_store(p, depth, beta, TT_LOWER, p->gen_dat[i0].m);
+				return beta;
+			}
+			alpha = x;
+			best = p->gen_dat[i0].m;
+
+			/* update the PV */
+			p->pv[p->ply][p->ply] = p->gen_dat[i0].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
+		}
+		i0++;
+		break;
+	}
+
+	/* search the rest of the moves on the workers */
+	for (i = i0; i < p->first_move[p->ply + 1]; ++i)
+		sort(p, i);
+	alpha = net_split(p, alpha, beta, depth, i0, &best, &f, &cut);
+	if (stop_search.val)
+		return alpha;
+	if (cut) {
+		tt_store(p, depth, beta, TT_LOWER, best);
+		return beta;
+	}
+
+	/* no legal moves? then we're in checkmate or stalemate */
+	if (!f) {
+		if (c)
+			return -10000 + p->ply;
+		else
+			return 0;
+	}
+
+	/* fifty move draw rule */
+	if (p->fifty >= 100)
+		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
+	return alpha;
+}
+
+
+/* net_split() searches the moves from from to first_move[ply + 1] on
+   the workers, handing the next move to each worker as it comes free.
+   A move no worker can take (because they're gone) is searched here.
+   It returns the new alpha, and updates best, the PV, and f (if there
+   were legal moves) to go with it. If a move fails high, it sets cut
+   and tells the other workers to stop. */
+
+int net_split(pos_t *p, int alpha, int beta, int depth, int from,
+		move *best, BOOL *f, BOOL *cut)
+{
+	int i, k, busy = 0, next = from;
+	BOOL stopping = FALSE;
+	mp_result r;
+
+	*cut = FALSE;
+	for (;;) {
+
+		/* give every idle worker the next legal move */
+		for (k = 0; k < net_workers && !*cut && !stop_search.val; ++k) {
+			if (net_fd[k] < 0 || net_move[k] != -1)
+				continue;
+			if (next >= p->first_move[p->ply + 1])
+				break;
+			*f = TRUE;
+			i = next++;
+			if (net_send(p, k, i, alpha, beta, depth))
+				++busy;
+			else {
+				net_local(p, i, alpha, beta, depth, &r);
+				alpha = net_merge(p, i, &r, alpha, beta, depth, best, cut);
+			}
+		}
+
+		/* with no workers left, search the rest of the moves here */
+		if (!busy) {
+			if (next >= p->first_move[p->ply + 1] || *cut || stop_search.val)
+				break;
+			*f = TRUE;
+			i = next++;
+			net_local(p, i, alpha, beta, depth, &r);
+			alpha = net_merge(p, i, &r, alpha, beta, depth, best, cut);
+			continue;
+		}
+
+		/* once the results don't matter, stop the workers */
+		if ((*cut || stop_search.val) && !stopping) {
+			for (k = 0; k < net_workers; ++k)
+				if (net_move[k] != -1)
+					write(net_fd[k], "stop\n", 5);
+			stopping = TRUE;
+		}
+
+		/* wait for a worker to finish, and merge its result */
+		k = net_wait(&r);
+		if (k < 0)
+			continue;
+		i = net_move[k];
+		net_move[k] = -1;
+		--busy;
+		if (net_fd[k] < 0) {  /* it died, so search its move here */
+			if (stopping)
+				continue;
+			net_local(p, i, alpha, beta, depth, &r);
+		}
+		p->nodes += r.nodes;
+		if (r.stopped && !stopping)
+			stop_search.val = TRUE;  /* its clock beat ours */
+		alpha = net_merge(p, i, &r, alpha, beta, depth, best, cut);
+	}
+	return alpha;
+}
+
+
+/* net_merge() merges the result r of move i into net_split()'s alpha,
+   best, cut and PV, and returns the new alpha. */
+
+int net_merge(pos_t *p, int i, mp_result *r, int alpha, int beta,
+		int depth, move *best, BOOL *cut)
+{
+	int j;
+
+	if (stop_search.val || *cut || r->score <= alpha)
+		return alpha;
+	p->history[(int)p->gen_dat[i].m.b.from][(int)p->gen_dat[i].m.b.to] += depth;
+	*best = p->gen_dat[i].m;
+	if (r->score >= beta) {
+		*cut = TRUE;
+		return alpha;
+	}
+	p->pv[p->ply][p->ply] = *best;
+	for (j = 0; j < r->pv_length && p->ply + 1 + j < MAX_PLY; ++j)
+		p->pv[p->ply][p->ply + 1 + j] = r->pv[j];
+	p->pv_length[p->ply] = p->ply + 1 + j;
+	return r->score;
+}
+
+
+/* net_local() searches move i of position p here, for a move that no
+   worker can take, and puts the result in r as a worker would. */
+
+void net_local(pos_t *p, int i, int alpha, int beta, int depth,
+		mp_result *r)
+{
+	int j;
+
+	makemove(p, p->gen_dat[i].m.b);
+	r->score = -search(p, -beta, -alpha, depth - 1);
+	takeback(p);
+	r->stopped = FALSE;
+	r->nodes = 0;  /* they're counted in p->nodes already */
+	r->pv_length = 0;
+	for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+		r->pv[r->pv_length++] = p->pv[p->ply + 1][j];
+}
+
+
+/* net_send() sends worker k a job: move i of position p, to search
+   with the given window and depth in whatever time the search has
+   left. If the worker's gone, it's dropped, and net_send() returns
+   FALSE. */
+
+BOOL net_send(pos_t *p, int k, int i, int alpha, int beta, int depth)
+{
+	char s[NET_LINE];
+	int j, ms;
+
+	ms = max_time - (get_ms() - start_time);
+	if (ms < 1)
+		ms = 1;
+	sprintf(s, "job %d %d %d %d %d %s|%s|", alpha, beta, depth, p->ply, ms,
+			move_str(p->gen_dat[i].m.b), net_fen);
+	for (j = p->hply - p->ply; j < p->hply; ++j) {
+		strcat(s, " ");
+		strcat(s, move_str(p->hist_dat[j].m.b));
+	}
+	strcat(s, "\n");
+	if (write(net_fd[k], s, strlen(s)) < 0) {
+		net_drop(k);
+		return FALSE;
+	}
+	net_move[k] = i;
+	return TRUE;
+}
+
+
+/* net_drop() closes the connection to worker k, which has gone away,
+   and says so. It isn't sent any more moves. */
+
+void net_drop(int k)
+{
+	fclose(net_in[k]);
+	net_fd[k] = -1;
+	printf("Lost worker %d; searching its moves here.\n", k);
+}
+
+
+/* net_wait() waits for a busy worker to send its result, reads it into
+   r, and returns the worker's index. It gives up after 10 ms, returning
+   -1, so the caller can check whether it should stop the workers. A
+   worker that disconnects, or sends something that isn't a result, is
+   dropped (see net_drop()), and its move is left for the caller to
+   search. */
+
+int net_wait(mp_result *r)
+{
+	int k, n, from, to, promote, bits, off;
+	char s[NET_LINE], *c;
+	struct pollfd fds[MAX_THREADS];
+	int who[MAX_THREADS];
+
+	n = 0;
+	for (k = 0; k < net_workers; ++k)
+		if (net_move[k] != -1) {
+			fds[n].fd = net_fd[k];
+			fds[n].events = POLLIN;
+			who[n++] = k;
+		}
+	if (poll(fds, n, 10) <= 0)
+		return -1;
+	for (k = 0; k < n; ++k)
+		if (fds[k].revents)
+			break;
+	k = who[k];
+
+	r->stopped = FALSE;
+	r->score = -10001;
+	r->nodes = 0;
+	r->pv_length = 0;
+	if (!fgets(s, sizeof(s), net_in[k]) ||
+			sscanf(s, "result %d %d %d%n", &r->stopped, &r->score, &r->nodes,
+			&off) < 3) {
+		net_drop(k);
+		return k;
+	}
+	for (c = s + off; r->pv_length < MAX_PLY &&
+			sscanf(c, " %d,%d,%d,%d%n", &from, &to, &promote, &bits, &off) == 4;
+			c += off) {
+		r->pv[r->pv_length].b.from = (char)from;
+		r->pv[r->pv_length].b.to = (char)to;
+		r->pv[r->pv_length].b.promote = (char)promote;
+		r->pv[r->pv_length++].b.bits = (char)bits;
+	}
+	return k;
+}
+
+
+/* net_serve() makes this engine a worker, listening on port. It serves
+   one master at a time, and never returns unless it can't listen. */
+
+void net_serve(int port)
+{
+	int s, fd, one = 1;
+	BOOL running = FALSE;
+	char line[NET_LINE];
+	struct sockaddr_in a;
+	pthread_t t;
+	FILE *in;
+
+	s = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(s, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_addr.s_addr = htonl(INADDR_ANY);
+	a.sin_port = htons(port);
+	if (s < 0 || bind(s, (struct sockaddr *)&a, sizeof(a)) || listen(s, 1)) {
+		printf("Can't listen on port %d.\n", port);
+		if (s >= 0)
+			close(s);
+		return;
+	}
+	printf("Serving on port %d.\n", port);
+	fflush(stdout);
+	signal(SIGPIPE, SIG_IGN);
+	eval_func = &eval;
+	quiesce_func = &quiesce;
+
+	for (;;) {
+		fd = accept(s, NULL, NULL);
+		if (fd < 0)
+			continue;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		in = fdopen(fd, "r");
+		net_out = fd;
+		while (fgets(line, sizeof(line), in)) {
+			if (!strncmp(line, "stop", 4))
+				stop_search.val = TRUE;
+			else if (!strncmp(line, "job ", 4)) {
+				if (running)
+					pthread_join(t, NULL);
+				strcpy(net_job, line + 4);
+				stop_search.val = FALSE;
+				running = !pthread_create(&t, NULL, &net_work, NULL);
+			}
+		}
+		stop_search.val = TRUE;
+		if (running)
+			pthread_join(t, NULL);
+		running = FALSE;
+		fclose(in);
+	}
+}
+
+
+/* net_work() searches the job in net_job, on a thread of its own so
+   that net_serve() can keep reading (and see a "stop"), and sends the
+   result to the master. */
+
+void *net_work(void *arg)
+{
+	int alpha, beta, depth, ply, ms, i, x;
+	char mv[8], s[NET_LINE], *fen, *moves, *tok;
+	BOOL ok;
+	pos_t *p = &pos_dat[0];
+
+	p->nodes = 0;
+	fen = strchr(net_job, '|');
+	moves = fen ? strchr(fen + 1, '|') : NULL;
+	ok = moves != NULL;
+	if (ok) {
+		*fen++ = '\0';
+		*moves++ = '\0';
+		ok = sscanf(net_job, "%d %d %d %d %d %7s", &alpha, &beta, &depth,
+				&ply, &ms, mv) == 6 && ply >= 0 && ply < MAX_PLY - 1 &&
+				fen_parse(p, fen);
+	}
+
+	/* the master's game history before its root isn't sent, so there
+	   are blank entries for reps() to look back over */
+	if (ok) {
+		set_hash(p);
+		p->hply = p->fifty < HIST_STACK / 2 ? p->fifty : HIST_STACK / 2;
+		memset(p->hist_dat, 0, p->hply * sizeof(hist_t));
+		p->ply = 0;
+		p->follow_pv = FALSE;
+		p->split = NULL;
+		for (tok = strtok(moves, " \n"); tok && ok; tok = strtok(NULL, " \n"))
+			ok = net_make(p, tok);
+		ok = ok && net_make(p, mv);
+	}
+
+	/* search at the master's ply, so mate scores (which count the ply
+	   from the root) mean the same to it */
+	x = 0;
+	if (ok) {
+		p->ply = ply + 1;
+		p->first_move[p->ply] = 0;
+		timer_start(ms);
+		x = -search(p, -beta, -alpha, depth - 1);
+		timer_stop();
+		takeback(p);
+	}
+	sprintf(s, "result %d %d %d", !ok || stop_search.val, x, p->nodes);
+	if (ok)
+		for (i = ply + 1; i < p->pv_length[ply + 1] &&
+				strlen(s) < NET_LINE - 32; ++i)
+			sprintf(s + strlen(s), " %d,%d,%d,%d", p->pv[ply + 1][i].b.from,
+					p->pv[ply + 1][i].b.to, p->pv[ply + 1][i].b.promote,
+					p->pv[ply + 1][i].b.bits);
+	strcat(s, "\n");
+	write(net_out, s, strlen(s));
+	return NULL;
+}
+
+
+/* net_make() makes the move s (in coordinate notation) on position p,
+   as the new root of its search. It returns FALSE if s isn't a legal
+   move. */
+
+BOOL net_make(pos_t *p, char *s)
+{
+	int i;
+
+	p->ply = 0;
+	p->first_move[0] = 0;
+	gen(p);
+	if (s[4])
+		s[4] = toupper(s[4]);  /* move_str() writes promotions in lowercase */
+	i = parse_move(p, s);
+	if (i == -1)
+		return FALSE;
+	makemove(p, p->gen_dat[i].m.b);
+	p->ply = 0;
+	return TRUE;
+}
@@ -0,0 +1,187 @@
+/*
+ *	NUMA.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#define _GNU_SOURCE  /* for sched_setaffinity() */
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <omp.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This keeps the search threads near their memory on machines with
+   more than one NUMA node (e.g., a server with two sockets). Search
+   thread n always runs on processor numa_cpu[n], whether it's a pool
+   thread or in an OpenMP team, so pos_dat[n] stays on one node. Only
+   one of the pool and the team is pinned at a time, the one that runs
+   the search, since their idle threads spin for a while before they
+   sleep and would otherwise spin on the working threads' processors. The
+   threads fill up one node before moving on to the next, so a search
+   with few threads stays on one socket. The layout comes from sysfs;
+   without it, the machine is treated as one node. */
+
+#define NUMA_MAX_NODES	64
+
+cpu_set_t numa_all;  /* the processors we were given to start with */
+
+
+/* numa_init() reads the machine's layout. */
+
+void numa_init()
+{
+	char path[64];
+	int n, c, lo, hi, i;
+	BOOL found;
+	FILE *f;
+
+	CPU_ZERO(&numa_all);
+	sched_getaffinity(0, sizeof(numa_all), &numa_all);
+
+	/* each node's cpulist is a list of ranges, e.g., "0-7,16-23" */
+	numa_nodes = 0;
+	numa_size = 0;
+	for (n = 0; n < NUMA_MAX_NODES && numa_size < MAX_THREADS; ++n) {
+		sprintf(path, "/sys/devices/system/node/node%d/cpulist", n);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		found = FALSE;
+		while (fscanf(f, "%d", &lo) == 1) {
+			hi = lo;
+			c = fgetc(f);
+			if (c == '-') {
+				if (fscanf(f, "%d", &hi) != 1)
+					break;
+				c = fgetc(f);
+			}
+			for (i = lo; i <= hi && numa_size < MAX_THREADS; ++i)
+				if (CPU_ISSET(i, &numa_all)) {
+					numa_cpu[numa_size] = i;
+					numa_node[numa_size++] = n;
+					found = TRUE;
+				}
+			if (c != ',')
+				break;
+		}
+		fclose(f);
+		if (found)
+			++numa_nodes;
+	}
+
+	if (!numa_size) {
+		numa_nodes = 1;
+		for (i = 0; i < CPU_SETSIZE && numa_size < MAX_THREADS; ++i)
+			if (CPU_ISSET(i, &numa_all)) {
+				numa_cpu[numa_size] = i;
+				numa_node[numa_size++] = 0;
+			}
+	}
+
+	/* with more threads than processors nobody gets pinned, but
+	   the extra threads still need a node */
+	for (i = numa_size; i < MAX_THREADS; ++i) {
+		numa_cpu[i] = numa_cpu[i % numa_size];
+		numa_node[i] = numa_node[i % numa_size];
+	}
+}
+
+
+/* numa_pin() pins the calling thread, search thread id, to its
+   processor. If there are more threads than processors, it lets the
+   thread run anywhere instead, since they'll have to share. */
+
+void numa_pin(int id)
+{
+	cpu_set_t set;
+
+	if (threads > numa_size) {
+		numa_unpin();
+		return;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(numa_cpu[id], &set);
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+
+/* numa_unpin() lets the calling thread run on any processor again. */
+
+void numa_unpin()
+{
+	sched_setaffinity(0, sizeof(numa_all), &numa_all);
+}
+
+
+/* numa_team() pins the threads of the OpenMP team, which OpenMP keeps
+   from one parallel region to the next, and has each helper touch its
+   position first, so that Linux puts the pages on the helper's node.
+   It's called whenever the number of threads changes. Thread 0's
+   position is the game's, so it's left alone. The helpers are pinned
+   for the touch even if the pool has the processors. */
+
+void numa_team()
+{
+	int k;
+
+	#pragma omp parallel private(k)
+	{
+		k = omp_get_thread_num();
+		numa_pin(k);
+		if (k) {
+			memset(&pos_dat[k], 0, sizeof(pos_dat[k]));
+			pos_dat[k].id = k;
+			if (numa_pool.val)
+				numa_unpin();
+		}
+	}
+}
+
+
+/* numa_use() gives the processors to the pool's threads if pool is
+   TRUE, and to the OpenMP team's otherwise. The team's threads are
+   (un)pinned here; the pool's do it themselves in pool_main(). The
+   main thread is in both, so it stays pinned. */
+
+void numa_use(BOOL pool)
+{
+	int k;
+
+	if (numa_pool.val == pool)
+		return;
+	numa_pool.val = pool;
+	#pragma omp parallel private(k)
+	{
+		k = omp_get_thread_num();
+		if (k && pool)
+			numa_unpin();
+		else
+			numa_pin(k);
+	}
+}
+
+
+/* numa_print() prints the layout and where each search thread runs. */
+
+void numa_print()
+{
+	int i;
+
+	printf("%d NUMA node(s), %d processor(s)\n", numa_nodes, numa_size);
+	if (threads > numa_size) {
+		printf("%d threads is more than processors, so none are pinned\n",
+				threads);
+		return;
+	}
+	printf("thread  cpu  node\n");
+	for (i = 0; i < threads; ++i)
+		printf("%6d  %3d  %4d\n", i, numa_cpu[i], numa_node[i]);
+}
@@ -0,0 +1,251 @@
+/*
+ *	POOL.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This is a pool of worker threads for the parallel search functions
+   that split a single node (prs_search(), pvs_search(), and
+   p_quiesce()). The threads are started once, instead of every time a
+   node is split, and each one is pinned to its own processor. A thread
+   that splits a node pushes a task for each move onto its own deque;
+   idle threads steal tasks from the other end, from threads on their
+   own NUMA node first. Thread 0 is the main thread. Pool thread n
+   searches on pos_dat[n], pinned to the same processor as OpenMP
+   thread n (see numa.c). */
+
+#define POOL_SPIN		100000  /* idle loops before a thread sleeps */
+
+deque_t pool_deques[MAX_THREADS];
+pthread_t pool_threads[MAX_THREADS];
+int pool_size;
+BOOL pool_yield;  /* are there more threads than processors? */
+flag_t pool_queued;  /* tasks on all the deques */
+flag_t pool_sleepers;
+flag_t pool_quit;
+pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+
+
+/* pool_init() (re)starts the pool with n threads, counting the main
+   thread. */
+
+void pool_init(int n)
+{
+	long i;
+
+	pool_stop();
+	pool_quit.val = FALSE;
+	pool_size = n;
+	pool_yield = sysconf(_SC_NPROCESSORS_ONLN) < n;
+	for (i = 1; i < n; ++i)
+		pthread_create(&pool_threads[i], NULL, &pool_main, (void *)i);
+}
+
+
+/* pool_stop() stops all the threads in the pool but the main one. */
+
+void pool_stop()
+{
+	int i;
+
+	pthread_mutex_lock(&pool_mutex);
+	pool_quit.val = TRUE;
+	pthread_cond_broadcast(&pool_cond);
+	pthread_mutex_unlock(&pool_mutex);
+	for (i = 1; i < pool_size; ++i)
+		pthread_join(pool_threads[i], NULL);
+	pool_size = 1;
+}
+
+
+/* pool_main() is where the pool's threads spend their lives, stealing
+   tasks until they're told to quit. A thread that can't find any work
+   for a while goes to sleep until a task is pushed. */
+
+void *pool_main(void *arg)
+{
+	int spins = 0;
+	BOOL pinned = !numa_pool.val;
+	task_t t;
+	pos_t *p = &pos_dat[(long)arg];
+
+	while (!pool_quit.val) {
+
+		/* see numa_use() */
+		if (pinned != numa_pool.val) {
+			pinned = numa_pool.val;
+			if (pinned)
+				numa_pin(p->id);
+			else
+				numa_unpin();
+		}
+		if (pool_queued.val && pool_steal(p, &t)) {
+			(*t.func)(p, t.sp, t.i, TRUE);
+			spins = 0;
+		}
+		else if (++spins > POOL_SPIN) {
+			pthread_mutex_lock(&pool_mutex);
+			__sync_fetch_and_add(&pool_sleepers.val, 1);
+			while (!pool_queued.val && !pool_quit.val)
+				pthread_cond_wait(&pool_cond, &pool_mutex);
+			__sync_fetch_and_sub(&pool_sleepers.val, 1);
+			pthread_mutex_unlock(&pool_mutex);
+			spins = 0;
+		}
+		else if (pool_yield)
+			sched_yield();
+	}
+	return NULL;
+}
+
+
+/* pool_push() pushes a task onto the deque of the thread searching p. */
+
+void pool_push(pos_t *p, void (*func)(pos_t *, split_t *, int, BOOL),
+		split_t *sp, int i)
+{
+	deque_t *d = &pool_deques[p->id];
+	task_t *t;
+
+	LOCK(d->lock);
+	t = &d->task[d->tail++ % GEN_STACK];
+	t->func = func;
+	t->sp = sp;
+	t->i = i;
+	UNLOCK(d->lock);
+	__sync_fetch_and_add(&pool_queued.val, 1);
+	if (pool_sleepers.val) {
+		pthread_mutex_lock(&pool_mutex);
+		pthread_cond_broadcast(&pool_cond);
+		pthread_mutex_unlock(&pool_mutex);
+	}
+}
+
+
+/* pool_pop() pops a task off the deque of the thread searching p, but
+   only if it's for split point sp; tasks underneath it are for split
+   points further down the thread's stack, which it can't search from
+   here. */
+
+BOOL pool_pop(pos_t *p, split_t *sp, task_t *t)
+{
+	deque_t *d = &pool_deques[p->id];
+	BOOL found = FALSE;
+
+	LOCK(d->lock);
+	if (d->head < d->tail && d->task[(d->tail - 1) % GEN_STACK].sp == sp) {
+		*t = d->task[--d->tail % GEN_STACK];
+		found = TRUE;
+	}
+	if (d->head == d->tail)
+		d->head = d->tail = 0;
+	UNLOCK(d->lock);
+	if (found)
+		__sync_fetch_and_sub(&pool_queued.val, 1);
+	return found;
+}
+
+
+/* pool_steal() takes the oldest task from the first thread after the
+   one searching p that has any, looking on p's NUMA node first, since
+   a task stolen from there shares its split point's cache lines with
+   a thread on the same socket. */
+
+BOOL pool_steal(pos_t *p, task_t *t)
+{
+	int i, v, near;
+	deque_t *d;
+	BOOL found = FALSE;
+
+	for (near = 1; near >= 0 && !found; --near)
+		for (i = 1; i < pool_size && !found; ++i) {
+			v = (p->id + i) % pool_size;
+			d = &pool_deques[v];
+			if ((numa_node[v] == numa_node[p->id]) != near || d->head == d->tail)
+				continue;
+			LOCK(d->lock);
+			if (d->head < d->tail) {
+				*t = d->task[d->head++ % GEN_STACK];
+				found = TRUE;
+			}
+			if (d->head == d->tail)
+				d->head = d->tail = 0;
+			UNLOCK(d->lock);
+		}
+	if (found)
+		__sync_fetch_and_sub(&pool_queued.val, 1);
+	return found;
+}
+
+
+/* pool_wait() runs the tasks for split point sp on the deque of the
+   thread searching p until every task for sp is done, including the
+   ones other threads stole. If there are more threads than processors,
+   the thread gives up its processor while it waits, since the threads
+   it's waiting for might need it. */
+
+void pool_wait(pos_t *p, split_t *sp)
+{
+	task_t t;
+
+	while (sp->workers)
+		if (pool_pop(p, sp, &t))
+			(*t.func)(p, t.sp, t.i, FALSE);
+		else if (pool_yield)
+			sched_yield();
+}
+
+
+/* pool_mode() returns TRUE if the current search mode splits nodes
+   with the pool. */
+
+BOOL pool_mode()
+{
+	return search_func == &prs_search || search_func == &pvs_search ||
+			quiesce_func == &p_quiesce;
+}
+
+
+/* pool_noop() is a task that does nothing, for pool_cost(). */
+
+void pool_noop(pos_t *p, split_t *sp, int i, BOOL stolen)
+{
+	__sync_fetch_and_sub(&sp->workers, 1);
+}
+
+
+/* pool_cost() returns roughly how long, in nanoseconds, it takes to
+   split a node with pool_size moves that take no time to search: the
+   position is saved, a task is pushed for every thread, and the thread
+   waits for them. It times n such splits from the current position. */
+
+int pool_cost(int n)
+{
+	int i, j, t;
+	split_t sp;
+	pos_t *p = &pos_dat[0];
+
+	sp.parent = NULL;
+	sp.cutoff = FALSE;
+	t = get_ms();
+	for (i = 0; i < n; ++i) {
+		split_save(p, &sp);
+		sp.workers = pool_size;
+		for (j = 0; j < pool_size; ++j)
+			pool_push(p, &pool_noop, &sp, j);
+		pool_wait(p, &sp);
+	}
+	return (int)((get_ms() - t) * 1000000.0 / n);
+}
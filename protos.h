@@ -12,57 +12,223 @@
 /* prototypes */
 
 /* board.c */
-void init_board();
+void init_board(pos_t *p);
 void init_hash();
-int hash_rand();
-void set_hash();
-BOOL in_check(int s);
-BOOL attack(int sq, int s);
-void gen();
-void gen_caps();
-void gen_push(int from, int to, int bits);
-void gen_promote(int from, int to, int bits);
-BOOL makemove(move_bytes m);
-void takeback();
+U64 hash_rand();
+void set_hash(pos_t *p);
+void plist_set(pos_t *p);
+void plist_add(pos_t *p, int c, int sq);
+void plist_remove(pos_t *p, int c, int sq);
+void plist_move(pos_t *p, int c, int from, int to);
+BOOL in_check(pos_t *p, int s);
+BOOL attack(pos_t *p, int sq, int s);
+void gen(pos_t *p);
+void gen_caps(pos_t *p);
+void gen_pseudo(pos_t *p);
+void gen_legal(pos_t *p);
+BOOL move_legal(pos_t *p, move_bytes m);
+BOOL mailbox_in_check(pos_t *p, int s);
+BOOL mailbox_attack(pos_t *p, int sq, int s);
+void mailbox_gen(pos_t *p);
+void mailbox_gen_caps(pos_t *p);
+void gen_push(pos_t *p, int from, int to, int bits);
+void gen_promote(pos_t *p, int from, int to, int bits);
+void makemove(pos_t *p, move_bytes m);
+void takeback(pos_t *p);
+#ifdef COPY_MAKE
+void board_save(pos_t *p, board_t *b);
+void board_load(pos_t *p, board_t *b);
+#endif
+void pos_copy(pos_t *to, pos_t *from);
+U64 perft(pos_t *p, int depth);
+U64 perft_pseudo(pos_t *p, int depth);
+
+/* bitboard.c */
+void bb_init();
+U64 bb_slide(int sq, int dir[4][2], U64 occ, BOOL edges);
+int bb_init_magic(bb_magic *m, int sq, int dir[4][2], U64 *table);
+U64 bb_rand();
+U64 bb_rook_attacks(int sq, U64 occ);
+U64 bb_bishop_attacks(int sq, U64 occ);
+void bb_set(pos_t *p);
+BOOL bb_attack(pos_t *p, int sq, int s);
+BOOL bb_in_check(pos_t *p, int s);
+U64 bb_targets(pos_t *p, int sq);
+void bb_gen(pos_t *p);
+void bb_gen_caps(pos_t *p);
+int bb_check(pos_t *p, int depth, int *nodes);
+int bb_moves(pos_t *p, gen_t *a);
+int bb_compare(const void *a, const void *b);
+
+/* tt.c */
+void tt_init(int mb);
+BOOL tt_share();
+void tt_clear();
+void tt_new_search();
+BOOL tt_probe(pos_t *p, int depth, int alpha, int beta, int *score, move *m);
+void tt_store(pos_t *p, int depth, int score, int bound, move m);
+int tt_hashfull();
+void tt_hits(int *local, int *shared);
+void tt_pv(pos_t *p);
 
 /* book.c */
 void open_book();
 void close_book();
-int book_move();
+int book_move(pos_t *p);
 BOOL book_match(char *s1, char *s2);
 
 /* search.c */
-void think(int output);
-int search(int alpha, int beta, int depth);
-int prs_search(int alpha, int beta, int depth);
-int pvs_search(int alpha, int beta, int depth);
-int quiesce(int alpha, int beta);
-int p_quiesce(int alpha, int beta);
-int reps();
-void sort_pv();
-void sort(int from);
-BOOL timeout();
+void think(pos_t *p, int output);
+void iterate(pos_t *p, int output);
+void history_merge(pos_t *p);
+void lazy_iterate(pos_t *p, int output);
+int aspire_search(pos_t *p, int alpha, int beta, int depth);
+int search(pos_t *p, int alpha, int beta, int depth);
+int prs_search(pos_t *p, int alpha, int beta, int depth);
+int pvs_search(pos_t *p, int alpha, int beta, int depth);
+int ybw_search(pos_t *p, int alpha, int beta, int depth);
+int ybw_node(pos_t *p, int alpha, int beta, int depth);
+int ybw_split(pos_t *p, int alpha, int beta, int depth, int i, move *best);
+void ybw_work(pos_t *p, split_t *sp);
+void ybw_idle(pos_t *p, split_t *wait);
+split_t *ybw_join(pos_t *p, split_t *wait);
+BOOL split_ok(int depth, int moves);
+void split_learn(int depth, int n);
+BOOL split_aborted(split_t *sp);
+BOOL split_under(split_t *sp, split_t *wait);
+BOOL split_narrow(pos_t *p, int alpha, int *beta);
+void split_merge(pos_t *p, split_t *sp, move m, int x);
+void split_set(split_t *sp, pos_t *p, int ply, int alpha, move best);
+int split_result(pos_t *p, split_t *sp, move *best);
+void split_save(pos_t *p, split_t *sp);
+void split_load(pos_t *p, split_t *sp);
+int quiesce(pos_t *p, int alpha, int beta);
+int p_quiesce(pos_t *p, int alpha, int beta);
+BOOL par_split(pos_t *p, split_t *sp, int alpha, int beta, int depth,
+		int from, move best);
+void split_task(pos_t *p, split_t *sp, int i, BOOL stolen);
+int reps(pos_t *p);
+void sort_pv(pos_t *p);
+void sort_hash(pos_t *p, move m);
+void sort(pos_t *p, int from);
+int node_count();
 void omp_synchronize_state();
 
+/* pool.c */
+void pool_init(int n);
+void pool_stop();
+void *pool_main(void *arg);
+void pool_push(pos_t *p, void (*func)(pos_t *, split_t *, int, BOOL),
+		split_t *sp, int i);
+BOOL pool_pop(pos_t *p, split_t *sp, task_t *t);
+BOOL pool_steal(pos_t *p, task_t *t);
+void pool_wait(pos_t *p, split_t *sp);
+BOOL pool_mode();
+void pool_noop(pos_t *p, split_t *sp, int i, BOOL stolen);
+int pool_cost(int n);
+
+/* timer.c */
+U64 get_us();
+void timer_init();
+void *timer_main(void *arg);
+void timer_start(int ms);
+int timer_stop();
+
+/* mp.c */
+void mp_init(int n);
+void mp_stop();
+void mp_worker(int in, int out);
+int mp_search(pos_t *p, int alpha, int beta, int depth);
+int mp_merge(pos_t *p, int i, mp_result *r, int alpha, int beta,
+		int depth, move *best, BOOL *cut);
+void mp_local(pos_t *p, int i, int alpha, int beta, int depth,
+		mp_result *r);
+BOOL mp_send(pos_t *p, int k, int i, int alpha, int beta, int depth);
+void mp_drop(int k);
+int mp_wait(mp_result *r);
+BOOL mp_read(int fd, void *buf, int n);
+BOOL mp_write(int fd, void *buf, int n);
+
+/* net.c */
+BOOL net_connect(char *host, char *port);
+void net_disconnect();
+int net_search(pos_t *p, int alpha, int beta, int depth);
+int net_split(pos_t *p, int alpha, int beta, int depth, int from,
+		move *best, BOOL *f, BOOL *cut);
+int net_merge(pos_t *p, int i, mp_result *r, int alpha, int beta,
+		int depth, move *best, BOOL *cut);
+void net_local(pos_t *p, int i, int alpha, int beta, int depth,
+		mp_result *r);
+BOOL net_send(pos_t *p, int k, int i, int alpha, int beta, int depth);
+void net_drop(int k);
+int net_wait(mp_result *r);
+void net_serve(int port);
+void *net_work(void *arg);
+BOOL net_make(pos_t *p, char *s);
+
+/* numa.c */
+void numa_init();
+void numa_pin(int id);
+void numa_unpin();
+void numa_team();
+void numa_use(BOOL pool);
+void numa_print();
+
+/* abdada.c */
+int abdada_search(pos_t *p, int alpha, int beta, int depth);
+int abdada(pos_t *p, int alpha, int beta, int depth);
+BOOL abdada_busy(U64 key);
+void abdada_start(U64 key);
+void abdada_finish(U64 key);
+
+/* dts.c */
+int dts_search(pos_t *p, int alpha, int beta, int depth);
+int dts_run(dts_thread *th, int alpha, int beta, int depth, split_t *under);
+void dts_push(dts_thread *th, int alpha, int beta, int depth,
+		split_t *under, BOOL base);
+int dts_enter(pos_t *p, dts_frame *f, int *v);
+int dts_next(dts_thread *th, dts_frame *f, int *v);
+BOOL dts_result(pos_t *p, dts_frame *f, int x);
+int dts_end(pos_t *p, dts_frame *f, int *v);
+int dts_finish(dts_thread *th, dts_frame *f, int *v);
+void dts_leave(dts_thread *th, dts_frame *f);
+void dts_pause(dts_thread *th);
+void dts_idle(dts_thread *th, split_t *wait);
+void dts_work(dts_thread *th, split_t *sp, int gen_base);
+split_t *dts_join(split_t *wait);
+split_t *dts_steal(dts_thread *th, split_t *wait);
+int dts_pick(dts_thread *v, split_t *wait);
+split_t *dts_split(dts_thread *th, dts_thread *v, int j);
+split_t *dts_alloc();
+void dts_free(split_t *sp);
+void dts_sort(gen_t *g, int from, int last);
+
 /* eval.c */
-int eval();
-int p_eval();
-int eval_light_pawn(int sq);
-int eval_dark_pawn(int sq);
-int eval_light_king(int sq);
-int eval_lkp(int f);
-int eval_dark_king(int sq);
-int eval_dkp(int f);
+int eval(pos_t *p);
+int p_eval(pos_t *p);
+int eval_light_pawn(eval_t *e, int sq);
+int eval_dark_pawn(eval_t *e, int sq);
+int eval_light_king(eval_t *e, int sq);
+int eval_lkp(eval_t *e, int f);
+int eval_dark_king(eval_t *e, int sq);
+int eval_dkp(eval_t *e, int f);
 
 /* main.c */
 int get_ms();
 int main();
-int parse_move(char *s);
+int parse_move(pos_t *p, char *s);
 char *move_str(move_bytes m);
-void print_board();
+void print_board(pos_t *p);
 void print_raw(int[64]);
 void xboard();
-void print_result();
+void print_result(pos_t *p);
+void print_tt_hits();
 void bench(char *fen, int iterations);
+void bench_all(char *fen);
+void bench_tune(char *fen);
+void bench_default(pos_t *p);
+void bench_parse(pos_t *p, char *fen);
+BOOL fen_parse(pos_t *p, char *fen);
+void fen_str(pos_t *p, char *s);
 
 #endif /* PROTOS_H */
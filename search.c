@@ -16,400 +16,1133 @@
 
 
 // private data structures for parallel search
-#pragma omp threadprivate(color, piece)
-#pragma omp threadprivate(side, xside, castle, ep, fifty, hash, ply, hply)
-#pragma omp threadprivate(gen_dat, first_move)
-#pragma omp threadprivate(hist_dat)
-#pragma omp threadprivate(pv, pv_length, follow_pv)
 
+/* split points for ybw_search(); each thread has a stack of
+   them, and its position's split field is the one it's working under */
+#define MAX_SPLITS		8  /* split points per thread */
 
-/* booleans for when search should stop */
-BOOL stop_search;
-BOOL cutoff;
+split_t ybw_splits[MAX_THREADS][MAX_SPLITS];
+int ybw_nsplits[MAX_THREADS];
+flag_t ybw_idlers;  /* threads looking for a split point to join */
+flag_t ybw_done;
 
+/* aspiration windows for aspire_search(); the windows' threads all
+   work under aspire_sp, which is never split, so that setting its
+   cutoff flag cancels the windows still searching */
+#define ASPIRE_WIDTH	20  /* width of each of the inner windows */
 
-/* think() calls search() iteratively. Search statistics
-   are printed depending on the value of output:
+split_t aspire_sp;
+int aspire_last;  /* the previous iteration's score */
+int aspire_win;  /* the thread whose window held the score, or -1 */
+int aspire_score;
+
+/* the history table every thread started the current iteration with */
+int history_base[64][64];
+
+
+/* think() sets up a search and calls iterate_func to do it.
+   Search statistics are printed depending on the value of output:
    0 = no output
    1 = normal output
    2 = xboard format output */
 
-void think(int output)
+void think(pos_t *p, int output)
 {
-	int i, j, x;
+	int i;
 
 	/* try the opening book first */
-	pv[0][0].u = book_move();
-	if (pv[0][0].u != -1)
+	p->pv[0][0].u = book_move(p);
+	if (p->pv[0][0].u != -1)
 		return;
 
 	start_time = get_ms();
-	stop_time = start_time + max_time;
 
-	ply = 0;
-	nodes = 0;
+	p->ply = 0;
+	tt_new_search();
+
+	memset(p->pv, 0, sizeof(p->pv));
+
+	/* give the other threads their own copies of the position */
+	for (i = 1; i < threads; ++i)
+		pos_copy(&pos_dat[i], p);
+	for (i = 0; i < MAX_THREADS; ++i) {
+		pos_dat[i].nodes = 0;
+		pos_dat[i].tt_probes = 0;
+		pos_dat[i].tt_local_hits = 0;
+		pos_dat[i].tt_hits = 0;
+		memset(pos_dat[i].history, 0, sizeof(pos_dat[i].history));
+	}
+	memset(history_base, 0, sizeof(history_base));
+		
+	/* pin the threads that will do the search */
+	numa_use(pool_mode());
+
+	stop_search.val = FALSE;
+	timer_start(max_time);
+	(*iterate_func)(p, output);
+	stop_latency = timer_stop();
+	
+	/* make sure to take back the line we were searching */
+	while (p->ply)
+		takeback(p);
+}
+
+
+/* iterate() calls search_func iteratively, printing the
+   result of each iteration. */
+
+void iterate(pos_t *p, int output)
+{
+	int i, j, x;
 
-	memset(pv, 0, sizeof(pv));
-	memset(history, 0, sizeof(history));
 	if (output == 1)
 		printf("ply      nodes  score  pv\n");
-		
-	stop_search = FALSE;
-	cutoff = FALSE;
 	for (i = 1; i <= max_depth; ++i) {
-		follow_pv = TRUE;
-		x = (*search_func)(-10000, 10000, i);
-		if (stop_search)
+		p->follow_pv = TRUE;
+		x = (*search_func)(p, -10000, 10000, i);
+		if (stop_search.val)
 			break;
+		search_score = x;
 			
 		if (output == 1)
-			printf("%3d  %9d  %5d ", i, nodes, x);
+			printf("%3d  %9d  %5d ", i, node_count(), x);
 		else if (output == 2)
-			printf("%d %d %d %d", i, x, (get_ms() - start_time) / 10, nodes);
+			printf("%d %d %d %d", i, x, (get_ms() - start_time) / 10,
+					node_count());
 		if (output) {
-			for (j = 0; j < pv_length[0]; ++j)
-				printf(" %s", move_str(pv[0][j].b));
+			for (j = 0; j < p->pv_length[0]; ++j)
+				printf(" %s", move_str(p->pv[0][j].b));
 			printf("\n");
 			fflush(stdout);
 		}
 		
 		if (x > 9000 || x < -9000)
 			break;
+		history_merge(p);
+	}
+}
+
+
+/* history_merge() pools what the threads have learned about move
+   ordering during an iteration. Each thread has added to its own copy
+   of history_base, the table they all started the iteration with; the
+   merged table is history_base plus all of their additions, and every
+   thread starts the next iteration with it. Lazy SMP's helpers never
+   stop between iterations, so inside an OpenMP team each thread just
+   keeps its own table. */
+
+void history_merge(pos_t *p)
+{
+	int i, j, k;
+
+	if (threads < 2 || omp_in_parallel())
+		return;
+	for (i = 0; i < 64; ++i)
+		for (j = 0; j < 64; ++j)
+			for (k = 1; k < threads; ++k)
+				p->history[i][j] += pos_dat[k].history[i][j] - history_base[i][j];
+	memcpy(history_base, p->history, sizeof(history_base));
+	for (k = 1; k < threads; ++k)
+		memcpy(pos_dat[k].history, p->history, sizeof(p->history));
+}
+
+
+/* lazy_iterate() is a "Lazy SMP" search: every thread does its own
+   iterative deepening on a private copy of the board, sharing nothing
+   but the transposition table and stop_search. Thread 0's search is the
+   real one; the helpers only fill the table with results it can use.
+   Odd helpers search one ply deeper than even ones, so the threads
+   don't all search the same tree in lockstep. When thread 0 is done it
+   sets stop_search, which stops the helpers. */
+
+void lazy_iterate(pos_t *p, int output)
+{
+	int i;
+	pos_t *h;
+
+	#pragma omp parallel private(i, h)
+	{
+		if (omp_get_thread_num() == 0) {
+			iterate(p, output);
+			stop_search.val = TRUE;
+		}
+		else {
+			h = &pos_dat[omp_get_thread_num()];
+			memset(h->pv, 0, sizeof(h->pv));
+			for (i = 1 + (omp_get_thread_num() & 1); i <= max_depth + 1; ++i) {
+				h->follow_pv = FALSE;
+				(*search_func)(h, -10000, 10000, i);
+				if (stop_search.val)
+					break;
+			}
+		}
 	}
-	
-	/* make sure to take back the line we were searching */
-	while (ply)
-		takeback();
+}
+
+
+/* aspire_search() does search in parallel with aspiration windows.
+   Each thread searches the whole tree serially, but with its own slice
+   of the range of scores: the slices are ASPIRE_WIDTH wide around the
+   previous iteration's score, and the outermost two reach out to alpha
+   and beta, so exactly one of them should hold the real score. The
+   first thread to get a score inside its window wins, and the others
+   are cancelled. If instability leaves every window failing, the
+   iteration is searched again with the full window. */
+
+int aspire_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, k, n, lo, hi, x;
+	pos_t *h;
+
+	/* the first iteration, and any after a mate score, get the full
+	   window */
+	if (depth == 1 || threads < 2 || aspire_last > 9000 || aspire_last < -9000) {
+		x = search(p, alpha, beta, depth);
+		if (!stop_search.val)
+			aspire_last = x;
+		return x;
+	}
+
+	/* the helpers follow the same PV as thread 0 */
+	for (i = 1; i < threads; ++i) {
+		h = &pos_dat[i];
+		memcpy(h->pv, p->pv, sizeof(p->pv));
+		memcpy(h->pv_length, p->pv_length, sizeof(p->pv_length));
+		h->follow_pv = p->follow_pv;
+	}
+
+	aspire_sp.parent = NULL;
+	aspire_sp.cutoff = FALSE;
+	aspire_sp.ply = MAX_PLY;  /* so split_narrow() leaves it alone */
+	aspire_win = -1;
+	#pragma omp parallel private(k, n, lo, hi, x, h)
+	{
+		k = omp_get_thread_num();
+		n = omp_get_num_threads();
+		h = k ? &pos_dat[k] : p;
+
+		/* window k holds scores from edge k to edge k + 1, less one */
+		lo = k ? aspire_last + (2 * k - n) * ASPIRE_WIDTH / 2 - 1 : alpha;
+		hi = k < n - 1 ? aspire_last + (2 * k + 2 - n) * ASPIRE_WIDTH / 2 : beta;
+		h->split = &aspire_sp;
+		x = search(h, lo, hi, depth);
+		h->split = NULL;
+		if (x > lo && x < hi && !stop_search.val &&
+				__sync_bool_compare_and_swap(&aspire_win, -1, k)) {
+			aspire_score = x;
+			aspire_sp.cutoff = TRUE;
+		}
+	}
+	if (stop_search.val)
+		return alpha;
+	if (aspire_win == -1) {
+		p->follow_pv = TRUE;
+		x = search(p, alpha, beta, depth);
+	}
+	else {
+		x = aspire_score;
+		h = aspire_win ? &pos_dat[aspire_win] : p;
+		if (h != p) {
+			memcpy(p->pv[0], h->pv[0], sizeof(p->pv[0]));
+			p->pv_length[0] = h->pv_length[0];
+		}
+	}
+	if (!stop_search.val)
+		aspire_last = x;
+	return x;
 }
 
 
 /* search() does just that, in negamax fashion */
 
-int search(int alpha, int beta, int depth)
+int search(pos_t *p, int alpha, int beta, int depth)
 {
 	int i, j, x;
 	BOOL c, f;
+	move best, hash_move;
 
 	/* we're as deep as we want to be; call quiesce() to get
 	   a reasonable score and return it. */
 	if (!depth)
-		return (*quiesce_func)(alpha,beta);
+		return (*quiesce_func)(p, alpha,beta);
 
-	#pragma omp atomic
-	++nodes;
+	++p->nodes;
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0 && timeout())
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
 		return alpha;
 
-	pv_length[ply] = ply;
+	p->pv_length[p->ply] = p->ply;
 
 	/* if this isn't the root of the search tree (where we have
 	   to pick a move and can't simply return 0) then check to
 	   see if the position is a repeat. if so, we can assume that
 	   this line is a draw and return 0. */
-	if (ply && reps())
+	if (p->ply && reps(p))
 		return 0;
 
 	/* are we too deep? */
-	if (ply >= MAX_PLY - 1)
-		return (*eval_func)();
-	if (hply >= HIST_STACK - 1)
-		return (*eval_func)();
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
 
 	/* are we in check? if so, we want to search deeper */
-	c = in_check(side);
+	c = in_check(p, p->side);
 	if (c)
 		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
 		
-	gen();
+	gen(p);
 	
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv();
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
 		
 	f = FALSE;
+	best.u = 0;
 
 	/* loop through the moves */
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
-		sort(i);
-		if (!makemove(gen_dat[i].m.b))
-			continue;
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		if (split_narrow(p, alpha, &beta))
+			return beta;
+		sort(p, i);
+		makemove(p, p->gen_dat[i].m.b);
 		f = TRUE;
-		x = -search(-beta, -alpha, depth - 1);
-		takeback();
-		if (stop_search)
+		x = -search(p, -beta, -alpha, depth - 1);
+		takeback(p);
+		if (stop_search.val || split_aborted(p->split))
 			return alpha;
 		if (x > alpha) {
 
 			/* this move caused a cutoff, so increase the history
 			   value so it gets ordered high next time we can
 			   search it */
-			history[(int)gen_dat[i].m.b.from][(int)gen_dat[i].m.b.to] += depth;
-			if (x >= beta)
+			p->history[(int)p->gen_dat[i].m.b.from][(int)p->gen_dat[i].m.b.to] += depth;
+			if (x >= beta) {
+				tt_store(p, depth, beta, TT_LOWER, p->gen_dat[i].m);
 				return beta;
+			}
 			alpha = x;
+			best = p->gen_dat[i].m;
 
 			/* update the PV */
-			pv[ply][ply] = gen_dat[i].m;
-			for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-				pv[ply][j] = pv[ply + 1][j];
-			pv_length[ply] = pv_length[ply + 1];
+			p->pv[p->ply][p->ply] = p->gen_dat[i].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
 		}
 	}
 
 	/* no legal moves? then we're in checkmate or stalemate */
 	if (!f) {
 		if (c)
-			return -10000 + ply;
+			return -10000 + p->ply;
 		else
 			return 0;
 	}
 
 	/* fifty move draw rule */
-	if (fifty >= 100)
+	if (p->fifty >= 100)
 		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
 	return alpha;
 }
 
 
 /* prs_search() does search in parallel by splitting the root node */
 
-int prs_search(int alpha, int beta, int depth)
+int prs_search(pos_t *p, int alpha, int beta, int depth)
 {
-	int i, j, x;
+	int i, x;
 	BOOL c, f;
+	move best, hash_move;
+	split_t sp;
 
 	/* we're as deep as we want to be; call quiesce() to get
 	   a reasonable score and return it. */
 	if (!depth)
-		return (*quiesce_func)(alpha,beta);
+		return (*quiesce_func)(p, alpha,beta);
 
-	++nodes;
+	++p->nodes;
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0 && timeout())
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
 		return alpha;
 
-	pv_length[ply] = ply;
+	p->pv_length[p->ply] = p->ply;
 
 	/* if this isn't the root of the search tree (where we have
 	   to pick a move and can't simply return 0) then check to
 	   see if the position is a repeat. if so, we can assume that
 	   this line is a draw and return 0. */
-	if (ply && reps())
+	if (p->ply && reps(p))
 		return 0;
 
 	/* are we too deep? */
-	if (ply >= MAX_PLY - 1)
-		return (*eval_func)();
-	if (hply >= HIST_STACK - 1)
-		return (*eval_func)();
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
 
 	/* are we in check? if so, we want to search deeper */
-	c = in_check(side);
+	c = in_check(p, p->side);
 	if (c)
 		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
 		
-	gen();
+	gen(p);
 	
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv();
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
 		
-	f = FALSE;
-	cutoff = FALSE;
-	best_pv_length = 0;
-	
-	/* loop through the moves */
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i)
-		sort(i);
-	#pragma omp parallel for schedule(dynamic,1) copyin(color, piece, \
-			side, xside, castle, ep, fifty, hash, ply, hply, \
-			gen_dat, first_move,  hist_dat, pv, pv_length, follow_pv) \
-			private(i, j, x)
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
-		if (stop_search || cutoff || !makemove(gen_dat[i].m.b))
-			continue;
-		f = TRUE;
-		x = -search(-beta, -alpha, depth - 1);
-		takeback();
-		#pragma omp critical
-		if (x > alpha && !cutoff) {
-			/* this move caused a cutoff, so increase the history
-			   value so it gets ordered high next time we can
-			   search it */
-			history[(int)gen_dat[i].m.b.from][(int)gen_dat[i].m.b.to] += depth;
-			if (x >= beta) {
-				cutoff = TRUE;
-			} else {
-				alpha = x;
-
-				// update the (local) PV
-				best_pv[ply] = pv[ply][ply] = gen_dat[i].m;
-				for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-					best_pv[j] = pv[ply][j] = pv[ply + 1][j];
-				best_pv_length = pv_length[ply] = pv_length[ply + 1];
-			}
-		}
-	}
-	
-	// update the PV
-	if (best_pv_length > 0) {
-		pv[ply][ply] = best_pv[ply];
-		for (j = ply + 1; j < best_pv_length; ++j)
-			pv[ply][j] = best_pv[j];
-		pv_length[ply] = best_pv_length;
+	/* search the moves on the thread pool */
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i)
+		sort(p, i);
+	best.u = 0;
+	f = par_split(p, &sp, alpha, beta, depth, p->first_move[p->ply], best);
+	if (stop_search.val || split_aborted(p->split))
+		return alpha;
+	alpha = split_result(p, &sp, &best);
+	if (sp.cutoff) {
+		tt_store(p, depth, beta, TT_LOWER, best);
+		return beta;
 	}
 
-	if (cutoff)
-		return beta;
-	
 	/* no legal moves? then we're in checkmate or stalemate */
 	if (!f) {
 		if (c)
-			return -10000 + ply;
+			return -10000 + p->ply;
 		else
 			return 0;
 	}
 
 	/* fifty move draw rule */
-	if (fifty >= 100)
+	if (p->fifty >= 100)
 		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
 	return alpha;
 }
 
 
 /* pvs_search() does search in parallel via principal variation splitting */
 
-int pvs_search(int alpha, int beta, int depth)
+int pvs_search(pos_t *p, int alpha, int beta, int depth)
 {
 	int i, i0, j, x;
 	BOOL c, f;
+	move best, hash_move;
+	split_t sp;
 
 	/* we're as deep as we want to be; call quiesce() to get
 	   a reasonable score and return it. */
 	if (!depth)
-		return (*quiesce_func)(alpha,beta);
+		return (*quiesce_func)(p, alpha,beta);
 
-	++nodes;
+	++p->nodes;
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0 && timeout())
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
 		return alpha;
 
-	pv_length[ply] = ply;
+	p->pv_length[p->ply] = p->ply;
 
 	/* if this isn't the root of the search tree (where we have
 	   to pick a move and can't simply return 0) then check to
 	   see if the position is a repeat. if so, we can assume that
 	   this line is a draw and return 0. */
-	if (ply && reps())
+	if (p->ply && reps(p))
 		return 0;
 
 	/* are we too deep? */
-	if (ply >= MAX_PLY - 1)
-		return (*eval_func)();
-	if (hply >= HIST_STACK - 1)
-		return (*eval_func)();
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
 
 	/* are we in check? if so, we want to search deeper */
-	c = in_check(side);
+	c = in_check(p, p->side);
 	if (c)
 		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
 		
-	gen();
+	gen(p);
 	
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv();
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
 		
 	f = FALSE;
-	cutoff = FALSE;
-	best_pv_length = 0;
+	best.u = 0;
 
 	// search first/PV variation before doing rest in parallel
-	for (i0 = first_move[ply]; i0 < first_move[ply + 1]; ++i0) {
-		sort(i0);
-		if (!makemove(gen_dat[i0].m.b))
-			continue;
+	for (i0 = p->first_move[p->ply]; i0 < p->first_move[p->ply + 1]; ++i0) {
+		sort(p, i0);
+		makemove(p, p->gen_dat[i0].m.b);
 		f = TRUE;
-		x = -pvs_search(-beta, -alpha, depth - 1);
-		takeback();
-		if (stop_search)
+		x = -pvs_search(p, -beta, -alpha, depth - 1);
+		takeback(p);
+		if (stop_search.val || split_aborted(p->split))
 			return alpha;
 		if (x > alpha) {
-			history[(int)gen_dat[i0].m.b.from][(int)gen_dat[i0].m.b.to] += depth;
-			if (x >= beta)
+			p->history[(int)p->gen_dat[i0].m.b.from][(int)p->gen_dat[i0].m.b.to] += depth;
+			if (x >= beta) {
+				tt_store(p, depth, beta, TT_LOWER, p->gen_dat[i0].m);
 				return beta;
+			}
 			alpha = x;
+			best = p->gen_dat[i0].m;
 
-			// update the (local) PV
-			best_pv[ply] = pv[ply][ply] = gen_dat[i0].m;
-			for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-				best_pv[j] = pv[ply][j] = pv[ply + 1][j];
-			best_pv_length = pv_length[ply] = pv_length[ply + 1];
+			/* update the PV */
+			p->pv[p->ply][p->ply] = p->gen_dat[i0].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
 		}
 		i0++;
 		break;
 	}
 	
+	/* search the rest of the moves on the thread pool */
+	for (i = i0; i < p->first_move[p->ply + 1]; ++i)
+		sort(p, i);
+	if (par_split(p, &sp, alpha, beta, depth, i0, best))
+		f = TRUE;
+	if (stop_search.val || split_aborted(p->split))
+		return alpha;
+	alpha = split_result(p, &sp, &best);
+	if (sp.cutoff) {
+		tt_store(p, depth, beta, TT_LOWER, best);
+		return beta;
+	}
+	
+	/* no legal moves? then we're in checkmate or stalemate */
+	if (!f) {
+		if (c)
+			return -10000 + p->ply;
+		else
+			return 0;
+	}
+
+	/* fifty move draw rule */
+	if (p->fifty >= 100)
+		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
+	return alpha;
+}
+
+
+/* par_split() searches the moves from from to first_move[ply + 1] on
+   the thread pool, making the current node split point sp. depth is
+   the depth left at the node; if it's 0, the moves get a quiescence
+   search. best is the best move so far, if any. The results are left
+   in sp (see split_result()). It returns FALSE if none of the moves
+   were legal. */
+
+BOOL par_split(pos_t *p, split_t *sp, int alpha, int beta, int depth,
+		int from, move best)
+{
+	int i;
+	BOOL f = FALSE;
+	BOOL inline_tasks;
+
+	/* inside an OpenMP team (e.g., Lazy SMP's) the pool isn't ours
+	   to use, and if the moves aren't worth splitting for, there's no
+	   point in handing them out; either way, just search them here,
+	   best first, stopping at a cutoff as search() would */
+	inline_tasks = omp_in_parallel() ||
+			!split_ok(depth, p->first_move[p->ply + 1] - from);
+	if (!inline_tasks)
+		split_save(p, sp);
+	sp->parent = p->split;
+	sp->lock = 0;
+	sp->cutoff = FALSE;
+	sp->beta = beta;
+	sp->depth = depth;
+	sp->ply = p->ply;  /* split_narrow() needs it, even inline */
+	sp->workers = 0;
+	sp->moves = p->gen_dat;
+	split_set(sp, p, p->ply, alpha, best);
+
+	if (inline_tasks) {
+		for (i = from; i < p->first_move[p->ply + 1] && !sp->cutoff; ++i) {
+			f = TRUE;
+			__sync_fetch_and_add(&sp->workers, 1);
+			split_task(p, sp, i, FALSE);
+		}
+		return f;
+	}
+
+	/* push the worst moves first, so this thread pops the best
+	   ones and other threads steal from the bottom of the list */
+	for (i = p->first_move[p->ply + 1] - 1; i >= from; --i) {
+		f = TRUE;
+		__sync_fetch_and_add(&sp->workers, 1);
+		pool_push(p, &split_task, sp, i);
+	}
+	pool_wait(p, sp);
+	return f;
+}
+
+
+/* split_task() searches move i of split point sp for par_split(). If
+   the task was stolen, the position has to be copied over first. The
+   thread works under sp while it searches the move, so that a cutoff
+   at sp or above it makes search() and quiesce() unwind as soon as
+   the moves they're searching return. */
+
+void split_task(pos_t *p, split_t *sp, int i, BOOL stolen)
+{
+	int a, x, n;
+	move m = sp->moves[i].m;
+	split_t *up = p->split;
+
+	a = SPLIT_ALPHA(sp->bound);
+	p->split = sp;
+	if (!stop_search.val && !split_aborted(p->split)) {
+		if (stolen)
+			split_load(p, sp);
+		n = p->nodes;
+		makemove(p, m.b);
+		if (sp->depth)
+			x = -search(p, -sp->beta, -a, sp->depth - 1);
+		else
+			x = -quiesce(p, -sp->beta, -a);
+		takeback(p);
+		if (!stop_search.val && !split_aborted(p->split)) {
+			split_learn(sp->depth, p->nodes - n);
+			split_merge(p, sp, m, x);
+		}
+	}
+	p->split = up;
+	__sync_fetch_and_sub(&sp->workers, 1);
+}
+
+
+/* ybw_search() does search in parallel using the Young Brothers Wait
+   Concept: any node may become a split point once its first (eldest)
+   move has been searched, as long as enough depth remains for the split
+   to pay off. Thread 0 searches from the root; the other threads wait in
+   ybw_idle() until there's a split point they can join. */
+
+int ybw_search(pos_t *p, int alpha, int beta, int depth)
+{
+	int x = alpha;
+	pos_t *h;
+
+	ybw_done.val = FALSE;
+	ybw_idlers.val = 0;
+	p->split = NULL;
+	#pragma omp parallel shared(x) private(h)
+	{
+		if (omp_get_thread_num() == 0) {
+			x = ybw_node(p, alpha, beta, depth);
+			ybw_done.val = TRUE;
+		}
+		else {
+			h = &pos_dat[omp_get_thread_num()];
+			h->split = NULL;
+			ybw_idle(h, NULL);
+		}
+	}
+	return x;
+}
+
+
+/* ybw_node() is search() with split points */
+
+int ybw_node(pos_t *p, int alpha, int beta, int depth)
+{
+	int i, j, x;
+	BOOL c, f;
+	move best, hash_move;
+
+	/* we're as deep as we want to be; call quiesce() to get
+	   a reasonable score and return it. */
+	if (!depth)
+		return (*quiesce_func)(p, alpha,beta);
+
+	++p->nodes;
+
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
+		return alpha;
+
+	p->pv_length[p->ply] = p->ply;
+
+	/* if this isn't the root of the search tree (where we have
+	   to pick a move and can't simply return 0) then check to
+	   see if the position is a repeat. if so, we can assume that
+	   this line is a draw and return 0. */
+	if (p->ply && reps(p))
+		return 0;
+
+	/* are we too deep? */
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
+
+	/* are we in check? if so, we want to search deeper */
+	c = in_check(p, p->side);
+	if (c)
+		++depth;
+
+	/* have we searched this position before? at the root we have
+	   to pick a move, so there we only use the table's move */
+	if (tt_probe(p, depth, alpha, beta, &x, &hash_move) && p->ply)
+		return x;
+		
+	gen(p);
+	
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+		
+	f = FALSE;
+	best.u = 0;
+
 	/* loop through the moves */
-	for (i = i0; i < first_move[ply + 1]; ++i)
-		sort(i);
-	#pragma omp parallel for schedule(dynamic,1) copyin(color, piece, \
-			side, xside, castle, ep, fifty, hash, ply, hply, \
-			gen_dat, first_move, hist_dat, pv, pv_length, follow_pv) \
-			private(i, j, x)
-	for (i = i0; i < first_move[ply + 1]; ++i) {
-		if (stop_search || cutoff || !makemove(gen_dat[i].m.b))
-			continue;
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		if (split_narrow(p, alpha, &beta))
+			return beta;
+
+		/* once the eldest brother has been searched, let idle
+		   threads help with the younger ones */
+		if (f && ybw_idlers.val > 0 &&
+				split_ok(depth, p->first_move[p->ply + 1] - i) &&
+				ybw_nsplits[p->id] < MAX_SPLITS) {
+			x = ybw_split(p, alpha, beta, depth, i, &best);
+			if (stop_search.val || split_aborted(p->split))
+				return alpha;
+			if (x >= beta) {
+				tt_store(p, depth, beta, TT_LOWER, best);
+				return beta;
+			}
+			alpha = x;
+			break;
+		}
+		sort(p, i);
+		makemove(p, p->gen_dat[i].m.b);
 		f = TRUE;
-		x = -search(-beta, -alpha, depth - 1);
-		takeback();
-		#pragma omp critical
-		if (x > alpha && !cutoff) {
-			/* this move caused a cutoff, so increase the history
-			   value so it gets ordered high next time we can
-			   search it */
-			history[(int)gen_dat[i].m.b.from][(int)gen_dat[i].m.b.to] += depth;
+		x = -ybw_node(p, -beta, -alpha, depth - 1);
+		takeback(p);
+		if (stop_search.val || split_aborted(p->split))
+			return alpha;
+		if (x > alpha) {
+			p->history[(int)p->gen_dat[i].m.b.from][(int)p->gen_dat[i].m.b.to] += depth;
 			if (x >= beta) {
-				cutoff = TRUE;
-			} else {
-				alpha = x;
-
-				// update the (local) PV
-				best_pv[ply] = pv[ply][ply] = gen_dat[i].m;
-				for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-					best_pv[j] = pv[ply][j] = pv[ply + 1][j];
-				best_pv_length = pv_length[ply] = pv_length[ply + 1];
+				tt_store(p, depth, beta, TT_LOWER, p->gen_dat[i].m);
+				return beta;
 			}
+			alpha = x;
+			best = p->gen_dat[i].m;
+
+			/* update the PV */
+			p->pv[p->ply][p->ply] = p->gen_dat[i].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
 		}
 	}
-	
-	// update the PV
-	if (best_pv_length > 0) {
-		pv[ply][ply] = best_pv[ply];
-		for (j = ply + 1; j < best_pv_length; ++j)
-			pv[ply][j] = best_pv[j];
-		pv_length[ply] = best_pv_length;
-	}
 
-	if (cutoff)
-		return beta;
-	
 	/* no legal moves? then we're in checkmate or stalemate */
 	if (!f) {
 		if (c)
-			return -10000 + ply;
+			return -10000 + p->ply;
 		else
 			return 0;
 	}
 
 	/* fifty move draw rule */
-	if (fifty >= 100)
+	if (p->fifty >= 100)
 		return 0;
+	tt_store(p, depth, alpha, best.u ? TT_EXACT : TT_UPPER, best);
 	return alpha;
 }
 
 
+/* ybw_split() turns the current node into a split point, starting
+   with move i. It searches the remaining moves together with any
+   threads that join, waits for them to finish, and returns the new
+   alpha (or beta, on a cutoff). best and the PV are updated too. */
+
+int ybw_split(pos_t *p, int alpha, int beta, int depth, int i, move *best)
+{
+	int j;
+	split_t *sp;
+
+	sp = &ybw_splits[p->id][ybw_nsplits[p->id]];
+
+	/* all threads pick moves off the front of the list, so
+	   it has to be sorted up front */
+	for (j = i; j < p->first_move[p->ply + 1]; ++j)
+		sort(p, j);
+
+	sp->parent = p->split;
+	sp->cutoff = FALSE;
+	sp->beta = beta;
+	sp->depth = depth;
+	sp->next = i;
+	sp->last = p->first_move[p->ply + 1];
+	sp->workers = 1;
+	sp->moves = p->gen_dat;
+	split_set(sp, p, p->ply, alpha, *best);
+	split_save(p, sp);
+	LOCK(sp->lock);
+	sp->active = TRUE;
+	UNLOCK(sp->lock);
+	++ybw_nsplits[p->id];
+	p->split = sp;
+
+	ybw_work(p, sp);
+	ybw_idle(p, sp);
+
+	LOCK(sp->lock);
+	sp->active = FALSE;
+	UNLOCK(sp->lock);
+	--ybw_nsplits[p->id];
+	p->split = sp->parent;
+
+	/* the board was overwritten if we helped elsewhere while waiting */
+	split_load(p, sp);
+	return split_result(p, sp, best);
+}
+
+
+/* ybw_work() searches moves at split point sp until there are none
+   left, then leaves the split point. */
+
+void ybw_work(pos_t *p, split_t *sp)
+{
+	int i, x, a, n;
+	move m;
+
+	for (;;) {
+		LOCK(sp->lock);
+		if (sp->cutoff || sp->next >= sp->last || stop_search.val) {
+			UNLOCK(sp->lock);
+			break;
+		}
+		i = sp->next++;
+		UNLOCK(sp->lock);
+		a = SPLIT_ALPHA(sp->bound);
+
+		m = sp->moves[i].m;
+		makemove(p, m.b);
+		n = p->nodes;
+		x = -ybw_node(p, -sp->beta, -a, sp->depth - 1);
+		takeback(p);
+		if (stop_search.val || split_aborted(p->split))
+			break;
+		split_learn(sp->depth, p->nodes - n);
+		split_merge(p, sp, m, x);
+	}
+
+	LOCK(sp->lock);
+	--sp->workers;
+	UNLOCK(sp->lock);
+}
+
+
+/* ybw_idle() is where a thread waits for work. Helper threads wait
+   here (with wait == NULL) until the search is over. A split point's
+   owner waits here for its helpers to finish (wait == its split
+   point), meanwhile helping only at split points below its own, since
+   those are the only ones it can be sure will finish first. */
+
+void ybw_idle(pos_t *p, split_t *wait)
+{
+	split_t *sp;
+
+	__sync_fetch_and_add(&ybw_idlers.val, 1);
+	for (;;) {
+		if (wait ? wait->workers == 0 : ybw_done.val)
+			break;
+		sp = ybw_join(p, wait);
+		if (!sp)
+			continue;
+		__sync_fetch_and_sub(&ybw_idlers.val, 1);
+		split_load(p, sp);
+		p->split = sp;
+		ybw_work(p, sp);
+		p->split = wait;
+		__sync_fetch_and_add(&ybw_idlers.val, 1);
+	}
+	__sync_fetch_and_sub(&ybw_idlers.val, 1);
+}
+
+
+/* ybw_join() looks for the split point with the most depth left that
+   still has moves to search, and joins it for the thread searching p.
+   Between split points with the same depth left, it prefers one owned
+   by a thread on p's NUMA node. If wait isn't NULL, only split points
+   below wait are considered. It returns NULL if there was nothing to
+   join. */
+
+split_t *ybw_join(pos_t *p, split_t *wait)
+{
+	int i, j;
+	BOOL near, bnear = FALSE;
+	split_t *sp, *bsp;
+
+	bsp = NULL;
+	for (i = 0; i < threads; ++i) {
+		near = numa_node[i] == numa_node[p->id];
+		for (j = 0; j < ybw_nsplits[i]; ++j) {
+			sp = &ybw_splits[i][j];
+			if (sp->active && !sp->cutoff && sp->next < sp->last &&
+					(!bsp || sp->depth > bsp->depth ||
+					(sp->depth == bsp->depth && near && !bnear))) {
+				bsp = sp;
+				bnear = near;
+			}
+		}
+	}
+	if (!bsp)
+		return NULL;
+
+	LOCK(bsp->lock);
+	if (!bsp->active || bsp->cutoff || bsp->next >= bsp->last) {
+		UNLOCK(bsp->lock);
+		return NULL;
+	}
+	if (wait && !split_under(bsp->parent, wait)) {
+		UNLOCK(bsp->lock);
+		return NULL;
+	}
+	++bsp->workers;
+	UNLOCK(bsp->lock);
+	return bsp;
+}
+
+
+/* split_ok() returns TRUE if a node with depth ply left and moves
+   moves left to search is worth splitting: it has to be deep enough,
+   have enough moves, and those moves have to be expected to take
+   enough nodes to pay for handing them out. Until split_learn() has
+   seen a move searched at some depth, we guess the tree grows by a
+   factor of four a ply. */
+
+BOOL split_ok(int depth, int moves)
+{
+	int d, size;
+
+	if (depth < split_depth || moves < split_moves)
+		return FALSE;
+	d = depth < MAX_PLY ? depth : MAX_PLY - 1;
+	size = split_size[d];
+	if (!size)
+		size = 1 << (2 * (d < 14 ? d : 14));
+	return (double)moves * size >= split_nodes;
+}
+
+
+/* split_learn() tells split_ok() that a move searched from a split
+   point with depth ply left took n nodes. It keeps a running average
+   that follows the last eight or so moves; the updates race, but a
+   lost one doesn't matter. */
+
+void split_learn(int depth, int n)
+{
+	int d = depth < MAX_PLY ? depth : MAX_PLY - 1;
+
+	if (!split_size[d])
+		split_size[d] = n > 0 ? n : 1;
+	else
+		split_size[d] += (n - split_size[d]) / 8;
+}
+
+
+/* split_aborted() returns TRUE if a move failed high at split point
+   sp, the one a thread is working under, or at any split point above
+   it. Whatever the thread is searching then isn't needed any more.
+   dts.c uses it too, so every mode cancels the same way. */
+
+BOOL split_aborted(split_t *sp)
+{
+	for (; sp; sp = sp->parent)
+		if (sp->cutoff)
+			return TRUE;
+	return FALSE;
+}
+
+
+/* split_under() returns TRUE if split point sp is wait or below it,
+   so that a split point whose parent is sp is below wait. It's how a
+   thread waiting at wait picks a split point to help at. */
+
+BOOL split_under(split_t *sp, split_t *wait)
+{
+	for (; sp; sp = sp->parent)
+		if (sp == wait)
+			return TRUE;
+	return FALSE;
+}
+
+
+/* split_narrow() is called before each move at a node. If the node
+   is the position after a move of the split point the thread is
+   working under, it narrows the node's window to fit the split point's
+   current alpha, which other threads may have raised since the move
+   was started: from the node's side, beta becomes -alpha. It returns
+   TRUE if that leaves the node failing high, in which case the move
+   can't improve the split point and the node can stop. */
+
+BOOL split_narrow(pos_t *p, int alpha, int *beta)
+{
+	int b;
+
+	if (!p->split || p->ply != p->split->ply + 1)
+		return FALSE;
+	b = -SPLIT_ALPHA(p->split->bound);
+	if (b < *beta)
+		*beta = b;
+	return alpha >= *beta;
+}
+
+
+/* split_merge() merges the score x of move m, which the thread
+   searching p searched from split point sp, into sp's result. There's
+   no lock: the thread writes its move and PV to its own slot, then
+   tries to point sp's bound at it with a compare-and-swap. If another
+   thread got there first with a better score, the slot just goes
+   unused. Nobody reads the slots until every thread has left sp. */
+
+void split_merge(pos_t *p, split_t *sp, move m, int x)
+{
+	int j;
+	U64 b;
+	split_slot *s = &sp->slot[p->id];
+
+	if (x > sp->beta)
+		x = sp->beta;
+	do {
+		b = sp->bound;
+		if (x <= SPLIT_ALPHA(b) || sp->cutoff)
+			return;
+		s->best = m;
+		if (x < sp->beta) {
+			s->pv[p->ply] = m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				s->pv[j] = p->pv[p->ply + 1][j];
+			s->pv_length = p->pv_length[p->ply + 1];
+		}
+	} while (!__sync_bool_compare_and_swap(&sp->bound, b,
+			SPLIT_BOUND(x, p->id)));
+	p->history[(int)m.b.from][(int)m.b.to] += sp->depth;
+	if (x >= sp->beta)
+		sp->cutoff = TRUE;
+}
+
+
+/* split_set() starts split point sp's result off at alpha, with best
+   and the PV at ply of position p as the moves that go with it. */
+
+void split_set(split_t *sp, pos_t *p, int ply, int alpha, move best)
+{
+	int j;
+	split_slot *s = &sp->slot[p->id];
+
+	s->best = best;
+	for (j = ply; j < p->pv_length[ply]; ++j)
+		s->pv[j] = p->pv[ply][j];
+	s->pv_length = p->pv_length[ply];
+	sp->bound = SPLIT_BOUND(alpha, p->id);
+}
+
+
+/* split_result() is called by split point sp's owner once every other
+   thread has left it. It returns sp's alpha (beta if a move failed
+   high), and sets best and the PV at the current ply from the slot
+   of the thread that found it. */
+
+int split_result(pos_t *p, split_t *sp, move *best)
+{
+	int j;
+	U64 b = sp->bound;
+	split_slot *s = &sp->slot[SPLIT_ID(b)];
+
+	if (s->best.u)
+		*best = s->best;
+	if (!sp->cutoff) {
+		for (j = p->ply; j < s->pv_length; ++j)
+			p->pv[p->ply][j] = s->pv[j];
+		p->pv_length[p->ply] = s->pv_length;
+	}
+	return SPLIT_ALPHA(b);
+}
+
+
+/* split_save() copies this thread's position to split point sp, so
+   other threads can search from it. Only the history from the root
+   of the search is copied; every thread's position already has the
+   game's history up to there. */
+
+void split_save(pos_t *p, split_t *sp)
+{
+	int i;
+
+	memcpy(sp->color, p->color, sizeof(p->color));
+	memcpy(sp->piece, p->piece, sizeof(p->piece));
+	sp->side = p->side;
+	sp->xside = p->xside;
+	sp->castle = p->castle;
+	sp->ep = p->ep;
+	sp->fifty = p->fifty;
+	sp->hash = p->hash;
+	sp->pawn_hash = p->pawn_hash;
+	sp->ply = p->ply;
+	sp->hply = p->hply;
+	sp->first_move = p->first_move[p->ply + 1];
+	for (i = 0; i < p->ply; ++i)
+		sp->hist[i] = p->hist_dat[p->hply - p->ply + i];
+}
+
+
+/* split_load() copies the position at split point sp to this thread's
+   board, so it can search moves from there. */
+
+void split_load(pos_t *p, split_t *sp)
+{
+	int i;
+
+	memcpy(p->color, sp->color, sizeof(p->color));
+	memcpy(p->piece, sp->piece, sizeof(p->piece));
+	p->side = sp->side;
+	p->xside = sp->xside;
+	p->castle = sp->castle;
+	p->ep = sp->ep;
+	p->fifty = sp->fifty;
+	p->hash = sp->hash;
+	p->pawn_hash = sp->pawn_hash;
+	p->ply = sp->ply;
+	p->hply = sp->hply;
+	for (i = 0; i < p->ply; ++i)
+		p->hist_dat[p->hply - p->ply + i] = sp->hist[i];
+	p->first_move[p->ply + 1] = sp->first_move;
+	p->follow_pv = FALSE;
+	plist_set(p);
+}
+
+
 /* quiesce() is a recursive minimax search function with
    alpha-beta cutoffs. In other words, negamax. But it
    only searches capture sequences and allows the evaluation
@@ -417,134 +1150,125 @@ int pvs_search(int alpha, int beta, int depth)
    is to find a position where there isn't a lot going on
    so the static evaluation function will work. */
 
-int quiesce(int alpha,int beta)
+int quiesce(pos_t *p, int alpha,int beta)
 {
 	int i, j, x;
+	int old_alpha = alpha;
+	move best, hash_move;
 	
-	#pragma omp atomic
-	++nodes;
+	++p->nodes;
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0 && timeout())
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
 		return alpha;
 
-	pv_length[ply] = ply;
+	p->pv_length[p->ply] = p->ply;
 
 	/* are we too deep? */
-	if (ply >= MAX_PLY - 1)
-		return (*eval_func)();
-	if (hply >= HIST_STACK - 1)
-		return (*eval_func)();
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
+
+	/* have we searched this position before? */
+	if (tt_probe(p, 0, alpha, beta, &x, &hash_move))
+		return x;
 
 	/* check with the evaluation function */
-	x = (*eval_func)();
+	x = (*eval_func)(p);
 	if (x >= beta)
 		return beta;
 	if (x > alpha)
 		alpha = x;
 		
-	gen_caps();
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv();
+	gen_caps(p);
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+	best.u = 0;
 	
 	/* loop through the moves */
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
-		sort(i);
-		if (!makemove(gen_dat[i].m.b))
-			continue;
-		x = -quiesce(-beta, -alpha);
-		takeback();
-		if (stop_search || cutoff)
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i) {
+		sort(p, i);
+		makemove(p, p->gen_dat[i].m.b);
+		x = -quiesce(p, -beta, -alpha);
+		takeback(p);
+		if (stop_search.val || split_aborted(p->split))
 			return alpha;
 		if (x > alpha) {
-			if (x >= beta)
+			if (x >= beta) {
+				tt_store(p, 0, beta, TT_LOWER, p->gen_dat[i].m);
 				return beta;
+			}
 			alpha = x;
+			best = p->gen_dat[i].m;
 
 			/* update the PV */
-			pv[ply][ply] = gen_dat[i].m;
-			for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-				pv[ply][j] = pv[ply + 1][j];
-			pv_length[ply] = pv_length[ply + 1];
+			p->pv[p->ply][p->ply] = p->gen_dat[i].m;
+			for (j = p->ply + 1; j < p->pv_length[p->ply + 1]; ++j)
+				p->pv[p->ply][j] = p->pv[p->ply + 1][j];
+			p->pv_length[p->ply] = p->pv_length[p->ply + 1];
 		}
 	}
+	tt_store(p, 0, alpha, alpha > old_alpha ? TT_EXACT : TT_UPPER, best);
 	return alpha;
 }
 
 
 /* p_quiesce() is a parallel version of quiesce(). */
 
-int p_quiesce(int alpha,int beta)
+int p_quiesce(pos_t *p, int alpha,int beta)
 {
-	int i, j, x;
-	move best;
+	int i, x;
+	int old_alpha = alpha;
+	move best, hash_move;
+	split_t sp;
 	
-	++nodes;
+	++p->nodes;
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0 && timeout())
+	/* has time run out? (see timer.c) */
+	if (stop_search.val)
 		return alpha;
 
-	pv_length[ply] = ply;
+	p->pv_length[p->ply] = p->ply;
 
 	/* are we too deep? */
-	if (ply >= MAX_PLY - 1)
-		return (*eval_func)();
-	if (hply >= HIST_STACK - 1)
-		return (*eval_func)();
+	if (p->ply >= MAX_PLY - 1)
+		return (*eval_func)(p);
+	if (p->hply >= HIST_STACK - 1)
+		return (*eval_func)(p);
+
+	/* have we searched this position before? */
+	if (tt_probe(p, 0, alpha, beta, &x, &hash_move))
+		return x;
 
 	/* check with the evaluation function */
-	x = (*eval_func)();
+	x = (*eval_func)(p);
 	if (x >= beta)
 		return beta;
 	if (x > alpha)
 		alpha = x;
 
-	gen_caps();
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv();
-
-	cutoff = FALSE;
-	best_pv_length = 0;
-			
-	/* loop through the moves */
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i)
-		sort(i);
-	#pragma omp parallel for schedule(dynamic,1) copyin(color, piece, \
-			side, xside, castle, ep, fifty, hash, ply, hply, \
-			gen_dat, first_move,  hist_dat, pv, pv_length, follow_pv) \
-			private(i, j, x)
-	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
-		if (stop_search || cutoff || !makemove(gen_dat[i].m.b))
-			continue;
-		x = -quiesce(-beta, -alpha);
-		takeback();
-		#pragma omp critical
-		if (x > alpha && !cutoff) {
-			if (x >= beta) {
-				cutoff = TRUE;
-			} else {
-				alpha = x;
-
-				// update the (local) PV
-				best_pv[ply] = pv[ply][ply] = gen_dat[i].m;
-				for (j = ply + 1; j < pv_length[ply + 1]; ++j)
-					best_pv[j] = pv[ply][j] = pv[ply + 1][j];
-				best_pv_length = pv_length[ply] = pv_length[ply + 1];
-			}
-		}
-	}
-	
-	// update the PV
-	if (best_pv_length > 0) {
-		pv[ply][ply] = best_pv[ply];
-		for (j = ply + 1; j < best_pv_length; ++j)
-			pv[ply][j] = best_pv[j];
-		pv_length[ply] = best_pv_length;
+	gen_caps(p);
+	if (p->follow_pv)  /* are we following the PV? */
+		sort_pv(p);
+	if (hash_move.u)
+		sort_hash(p, hash_move);
+
+	/* search the moves on the thread pool */
+	for (i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i)
+		sort(p, i);
+	best.u = 0;
+	par_split(p, &sp, alpha, beta, 0, p->first_move[p->ply], best);
+	if (stop_search.val || split_aborted(p->split))
+		return alpha;
+	alpha = split_result(p, &sp, &best);
+	if (sp.cutoff) {
+		tt_store(p, 0, beta, TT_LOWER, best);
+		return beta;
 	}
-	
-	if (cutoff)
-		return beta;	
+	tt_store(p, 0, alpha, alpha > old_alpha ? TT_EXACT : TT_UPPER, best);
 	return alpha;
 }
 
@@ -553,13 +1277,13 @@ int p_quiesce(int alpha,int beta)
    has been repeated. It compares the current value of hash
    to previous values. */
 
-int reps()
+int reps(pos_t *p)
 {
 	int i;
 	int r = 0;
 
-	for (i = hply - fifty; i < hply; ++i)
-		if (hist_dat[i].hash == hash)
+	for (i = p->hply - p->fifty; i < p->hply; ++i)
+		if (p->hist_dat[i].hash == p->hash)
 			++r;
 	return r;
 }
@@ -572,15 +1296,31 @@ int reps()
    by the search function. If not, follow_pv remains FALSE and
    search() stops calling sort_pv(). */
 
-void sort_pv()
+void sort_pv(pos_t *p)
 {
 	int i;
 
-	follow_pv = FALSE;
-	for(i = first_move[ply]; i < first_move[ply + 1]; ++i)
-		if (gen_dat[i].m.u == pv[0][ply].u) {
-			follow_pv = TRUE;
-			gen_dat[i].score += 10000000;
+	p->follow_pv = FALSE;
+	for(i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i)
+		if (p->gen_dat[i].m.u == p->pv[0][p->ply].u) {
+			p->follow_pv = TRUE;
+			p->gen_dat[i].score += 10000000;
+			return;
+		}
+}
+
+
+/* sort_hash() is like sort_pv(), only it looks for the move
+   the transposition table says was best the last time this
+   position was searched. It's ordered right after the PV move. */
+
+void sort_hash(pos_t *p, move m)
+{
+	int i;
+
+	for(i = p->first_move[p->ply]; i < p->first_move[p->ply + 1]; ++i)
+		if (p->gen_dat[i].m.u == m.u) {
+			p->gen_dat[i].score += 5000000;
 			return;
 		}
 }
@@ -592,7 +1332,7 @@ void sort_pv()
    highest score gets searched next, and hopefully produces
    a cutoff. */
 
-void sort(int from)
+void sort(pos_t *p, int from)
 {
 	int i;
 	int bs;  /* best score */
@@ -601,24 +1341,28 @@ void sort(int from)
 
 	bs = -1;
 	bi = from;
-	for (i = from; i < first_move[ply + 1]; ++i)
-		if (gen_dat[i].score > bs) {
-			bs = gen_dat[i].score;
+	for (i = from; i < p->first_move[p->ply + 1]; ++i)
+		if (p->gen_dat[i].score > bs) {
+			bs = p->gen_dat[i].score;
 			bi = i;
 		}
-	g = gen_dat[from];
-	gen_dat[from] = gen_dat[bi];
-	gen_dat[bi] = g;
+	g = p->gen_dat[from];
+	p->gen_dat[from] = p->gen_dat[bi];
+	p->gen_dat[bi] = g;
 }
 
 
-/* timeout() checks if the engine's time limit is up. */
+/* node_count() returns the number of nodes searched so far, by all
+   threads. Each thread counts its own nodes, so that they don't all
+   have to update the same counter. */
 
-BOOL timeout()
+int node_count()
 {
-	if (get_ms() >= stop_time) {
-		stop_search = TRUE;
-		return TRUE;
-	}
-	return FALSE;
+	int i;
+	int n = 0;
+
+	for (i = 0; i < MAX_THREADS; ++i)
+		n += pos_dat[i].nodes;
+	return n;
 }
+
@@ -0,0 +1,120 @@
+/*
+ *	TIMER.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#define _POSIX_C_SOURCE 200112L  /* for pthread_condattr_setclock() */
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* This is the search's clock. Instead of the search threads calling
+   get_ms() every so often to see if time is up, a timer thread sleeps
+   until the deadline and then sets stop_search, which the search
+   threads check at every node. Since checking it is just a read of a
+   cache line nobody writes until then, it's cheap enough to do
+   everywhere, and the search stops within a node or so of the
+   deadline on every thread. The timer notes when it fired, so think()
+   can tell how long the search took to stop. */
+
+pthread_t timer_thread;
+pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t timer_cond;
+struct timespec timer_deadline;
+BOOL timer_armed = FALSE;
+U64 timer_fired;  /* when stop_search was set, or 0 */
+
+
+/* get_us() returns microseconds on a clock that never jumps. */
+
+U64 get_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (U64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
+/* timer_init() starts the timer thread. */
+
+void timer_init()
+{
+	pthread_condattr_t attr;
+
+	/* a forked worker process (see mp.c) starts its own timer, and
+	   the mutex might have been held when it was forked */
+	pthread_mutex_init(&timer_mutex, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&timer_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_create(&timer_thread, NULL, &timer_main, NULL);
+}
+
+
+/* timer_main() waits for the timer to be started, then for the
+   deadline (or for the timer to be stopped), over and over. It
+   unpins itself first: it inherits the pin of the thread that started
+   it, which is search thread 0's processor, and it shouldn't have to
+   wait for that thread to be preempted when the deadline comes. */
+
+void *timer_main(void *arg)
+{
+	numa_unpin();
+	pthread_mutex_lock(&timer_mutex);
+	for (;;) {
+		if (!timer_armed)
+			pthread_cond_wait(&timer_cond, &timer_mutex);
+		else if (pthread_cond_timedwait(&timer_cond, &timer_mutex,
+				&timer_deadline) == ETIMEDOUT && timer_armed) {
+			__sync_lock_test_and_set(&stop_search.val, TRUE);
+			timer_fired = get_us();
+			timer_armed = FALSE;
+		}
+	}
+	return NULL;
+}
+
+
+/* timer_start() sets the timer to stop the search ms milliseconds
+   from now. */
+
+void timer_start(int ms)
+{
+	U64 t = get_us() + (U64)ms * 1000;
+
+	pthread_mutex_lock(&timer_mutex);
+	timer_deadline.tv_sec = t / 1000000;
+	timer_deadline.tv_nsec = (t % 1000000) * 1000;
+	timer_fired = 0;
+	timer_armed = TRUE;
+	pthread_cond_signal(&timer_cond);
+	pthread_mutex_unlock(&timer_mutex);
+}
+
+
+/* timer_stop() is called when the search has stopped. It stops the
+   timer, if it hasn't gone off, and returns how many microseconds ago
+   it did, or -1 if it didn't. */
+
+int timer_stop()
+{
+	int latency = -1;
+
+	pthread_mutex_lock(&timer_mutex);
+	if (timer_fired)
+		latency = (int)(get_us() - timer_fired);
+	timer_armed = FALSE;
+	pthread_cond_signal(&timer_cond);
+	pthread_mutex_unlock(&timer_mutex);
+	return latency;
+}
@@ -0,0 +1,364 @@
+/*
+ *	TT.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP), modified
+ *
+ *	Copyright 1997 Tom Kerrigan
+ *  Modifications: Copyright 2014 Vance Zuo
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <omp.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* an entry's data field is laid out like this:
+
+   bits  0-31	best move (move.u)
+   bits 32-47	score + 32768
+   bits 48-55	depth
+   bits 56-57	bound type (TT_EXACT, TT_UPPER, or TT_LOWER)
+   bits 58-63	age (tt_age when the entry was stored) */
+
+#define TT_MOVE(d)		((int)((d) & 0xffffffff))
+#define TT_SCORE(d)		((int)(((d) >> 32) & 0xffff) - 32768)
+#define TT_DEPTH(d)		((int)(((d) >> 48) & 0xff))
+#define TT_BOUND(d)		((int)(((d) >> 56) & 3))
+#define TT_AGE(d)		((int)(((d) >> 58) & 63))
+
+BOOL tt_shared = FALSE;  /* is the table in shared memory? */
+
+/* The shared table is much too big for any cache, so nearly every
+   probe of it is a trip to DRAM. Each thread therefore has a small
+   direct-mapped table of its own (tt_local in pos_t) in front of it.
+   A probe looks in the local table first, and copies what it finds in
+   the shared table into it. A store writes through to both, so the
+   other threads see it. A local entry may be older than the shared
+   one, but it was a real result for the position, so that's no worse
+   than another thread's store having been replaced. */
+
+
+/* tt_init() (re)allocates the transposition table to use at most
+   mb megabytes. The number of buckets is rounded down to a power
+   of 2. A size of 0 turns the table off. */
+
+void tt_init(int mb)
+{
+	U64 bytes = (U64)mb << 20;
+
+	if (tt_shared)
+		munmap(tt, (size_t)tt_size * TT_BUCKET * sizeof(tt_entry));
+	else
+		free(tt);
+	tt = NULL;
+	tt_shared = FALSE;
+	tt_size = 0;
+	if (mb <= 0)
+		return;
+	tt_size = 1;
+	while ((U64)tt_size * 2 * TT_BUCKET * sizeof(tt_entry) <= bytes)
+		tt_size *= 2;
+	tt = malloc((size_t)tt_size * TT_BUCKET * sizeof(tt_entry));
+	if (!tt)
+		tt_size = 0;
+	tt_clear();
+}
+
+
+/* tt_share() moves the transposition table into POSIX shared memory,
+   so that the processes mp_init() forks all use the same one. The
+   shared memory object is unlinked as soon as it's mapped, so it goes
+   away with the last process that has it mapped. It returns FALSE if
+   the table couldn't be moved. */
+
+BOOL tt_share()
+{
+	char name[32];
+	int fd;
+	size_t bytes = (size_t)tt_size * TT_BUCKET * sizeof(tt_entry);
+	tt_entry *t;
+
+	if (tt_shared || !tt)
+		return TRUE;
+	sprintf(name, "/tscp-tt-%d", (int)getpid());
+	fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0)
+		return FALSE;
+	shm_unlink(name);
+	if (ftruncate(fd, bytes)) {
+		close(fd);
+		return FALSE;
+	}
+	t = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED)
+		return FALSE;
+	memcpy(t, tt, bytes);
+	free(tt);
+	tt = t;
+	tt_shared = TRUE;
+	return TRUE;
+}
+
+
+/* tt_clear() empties the transposition table, e.g., for a new game.
+   Every search thread clears a slice of it, so that a new table's
+   pages are spread over the threads' NUMA nodes instead of all being
+   put on the main thread's. Each thread clears its own local table
+   as well, for the same reason. Positions that aren't in the team are
+   left alone; numa_team() clears them when they join it. */
+
+void tt_clear()
+{
+	int i;
+
+	#pragma omp parallel private(i)
+	{
+		memset(pos_dat[omp_get_thread_num()].tt_local, 0,
+				sizeof(pos_dat[0].tt_local));
+		if (tt) {
+			#pragma omp for
+			for (i = 0; i < tt_size; ++i)
+				memset(&tt[(size_t)i * TT_BUCKET], 0,
+						TT_BUCKET * sizeof(tt_entry));
+		}
+	}
+	tt_age = 0;
+}
+
+
+/* tt_new_search() is called at the start of every search, so
+   that entries left over from earlier searches get replaced
+   before entries from this one. */
+
+void tt_new_search()
+{
+	tt_age = (tt_age + 1) & 63;
+}
+
+
+/* tt_probe() looks up the current position in the transposition
+   table, the thread's local one first (and then the shared one, unless
+   the local entry is deep enough). If it's there, m is set to the best
+   move that was found for it (or 0 if there wasn't one). It returns
+   TRUE, and sets score, if the stored result was searched at least
+   depth ply and its bound lets us return it right away. */
+
+BOOL tt_probe(pos_t *p, int depth, int alpha, int beta, int *score, move *m)
+{
+	int i, s;
+	U64 data, d;
+	BOOL local;
+	tt_entry *e, *l;
+
+	m->u = 0;
+	if (!tt_size)
+		return FALSE;
+	++p->tt_probes;
+	l = &p->tt_local[p->hash & (TT_LOCAL_SIZE - 1)];
+	data = l->data;
+	local = (l->key ^ data) == p->hash;
+	if (local && TT_DEPTH(data) >= depth)
+		++p->tt_local_hits;
+	else {
+
+		/* the local entry is missing or too shallow, but another
+		   thread may have stored a deeper one in the shared table */
+		e = tt + (p->hash & (U64)(tt_size - 1)) * TT_BUCKET;
+		for (i = 0; i < TT_BUCKET; ++i) {
+			d = e[i].data;
+			if ((e[i].key ^ d) == p->hash)
+				break;
+		}
+		if (i < TT_BUCKET && (!local || TT_DEPTH(d) >= TT_DEPTH(data))) {
+			++p->tt_hits;
+			data = d;
+			l->key = p->hash ^ data;
+			l->data = data;
+		}
+		else if (!local)
+			return FALSE;
+	}
+
+	m->u = TT_MOVE(data);
+	if (TT_DEPTH(data) < depth)
+		return FALSE;
+
+	/* mate scores are stored relative to the position, so
+	   convert them back to be relative to the root */
+	s = TT_SCORE(data);
+	if (s > 9000)
+		s -= p->ply;
+	else if (s < -9000)
+		s += p->ply;
+	switch (TT_BOUND(data)) {
+		case TT_EXACT:
+			*score = s;
+			return TRUE;
+		case TT_UPPER:
+			if (s <= alpha) {
+				*score = alpha;
+				return TRUE;
+			}
+			break;
+		case TT_LOWER:
+			if (s >= beta) {
+				*score = beta;
+				return TRUE;
+			}
+			break;
+	}
+	return FALSE;
+}
+
+
+/* tt_store() saves a search result for the current position. If the
+   position is already in its bucket, that entry is overwritten,
+   unless it's deeper and the new result is only a bound; then it keeps
+   its result and just gets the new best move and age. Otherwise the entry replaced is the one from the oldest search
+   with the smallest depth. The result is also written to the thread's
+   local table. */
+
+void tt_store(pos_t *p, int depth, int score, int bound, move m)
+{
+	int i;
+	U64 data;
+	tt_entry *e, *r;
+
+	if (!tt_size)
+		return;
+
+	/* mate scores are stored relative to the position */
+	if (score > 9000)
+		score += p->ply;
+	else if (score < -9000)
+		score -= p->ply;
+
+	e = tt + (p->hash & (U64)(tt_size - 1)) * TT_BUCKET;
+	r = e;
+	for (i = 0; i < TT_BUCKET; ++i) {
+		data = e[i].data;
+		if ((e[i].key ^ data) == p->hash) {
+			if (!m.u)  /* keep the old best move if we don't have one */
+				m.u = TT_MOVE(data);
+			if (depth < TT_DEPTH(data) && bound != TT_EXACT) {
+				score = TT_SCORE(data);
+				depth = TT_DEPTH(data);
+				bound = TT_BOUND(data);
+			}
+			r = &e[i];
+			break;
+		}
+		if (TT_DEPTH(data) + (TT_AGE(data) == tt_age ? 256 : 0) <
+				TT_DEPTH(r->data) + (TT_AGE(r->data) == tt_age ? 256 : 0))
+			r = &e[i];
+	}
+
+	data = (U64)(unsigned int)m.u;
+	data |= (U64)(score + 32768) << 32;
+	data |= (U64)depth << 48;
+	data |= (U64)bound << 56;
+	data |= (U64)tt_age << 58;
+	r->key = p->hash ^ data;
+	r->data = data;
+	e = &p->tt_local[p->hash & (TT_LOCAL_SIZE - 1)];
+	e->key = r->key;
+	e->data = data;
+}
+
+
+/* tt_hashfull() returns how full the table is, in permill, by
+   sampling the first 1000 entries for ones stored by the current
+   search. */
+
+int tt_hashfull()
+{
+	int i, n, used;
+
+	if (!tt_size)
+		return 0;
+	n = tt_size * TT_BUCKET;
+	if (n > 1000)
+		n = 1000;
+	used = 0;
+	for (i = 0; i < n; ++i)
+		if (tt[i].data && TT_AGE(tt[i].data) == tt_age)
+			++used;
+	return used * 1000 / n;
+}
+
+
+/* tt_hits() sets local to the percentage of this search's probes that
+   hit in the threads' local tables, and shared to the percentage of the
+   rest that hit in the shared table. */
+
+void tt_hits(int *local, int *shared)
+{
+	int i;
+	double probes = 0, local_hits = 0, hits = 0;
+
+	for (i = 0; i < MAX_THREADS; ++i) {
+		probes += pos_dat[i].tt_probes;
+		local_hits += pos_dat[i].tt_local_hits;
+		hits += pos_dat[i].tt_hits;
+	}
+	*local = probes ? (int)(local_hits * 100 / probes) : 0;
+	*shared = probes > local_hits ?
+			(int)(hits * 100 / (probes - local_hits)) : 0;
+}
+
+
+/* tt_pv() fills out the PV from the best moves in the table. It keeps
+   the moves already in pv[0] and carries on from where they end, which
+   is needed when hash cutoffs at PV nodes cut the PV short. It stops at
+   a move that isn't legal (a key collision), or a repetition. */
+
+void tt_pv(pos_t *p)
+{
+	int i, j;
+	U64 data;
+	move m;
+	tt_entry *e, *l;
+
+	if (!tt_size)
+		return;
+	for (i = 0; i < MAX_PLY - 1; ++i) {
+		gen(p);
+		if (i < p->pv_length[0])
+			m = p->pv[0][i];
+		else {
+			l = &p->tt_local[p->hash & (TT_LOCAL_SIZE - 1)];
+			data = l->data;
+			if ((l->key ^ data) != p->hash) {
+				e = tt + (p->hash & (U64)(tt_size - 1)) * TT_BUCKET;
+				for (j = 0; j < TT_BUCKET; ++j) {
+					data = e[j].data;
+					if ((e[j].key ^ data) == p->hash)
+						break;
+				}
+				if (j == TT_BUCKET)
+					break;
+			}
+			m.u = TT_MOVE(data);
+		}
+		for (j = p->first_move[p->ply]; j < p->first_move[p->ply + 1]; ++j)
+			if (p->gen_dat[j].m.u == m.u)
+				break;
+		if (!m.u || j == p->first_move[p->ply + 1])
+			break;
+		p->pv[0][i] = m;
+		makemove(p, m.b);
+		if (reps(p))
+			break;
+	}
+	p->pv_length[0] = p->ply;
+	while (p->ply)
+		takeback(p);
+}